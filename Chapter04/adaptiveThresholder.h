@@ -0,0 +1,219 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 4 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined ADAPTTHRESH
+#define ADAPTTHRESH
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <vector>
+
+// Thresholds one band of rows.
+// The sums over the blockSize x blockSize neighborhood are obtained
+// from a rolling buffer of column sums and a single row of integral values;
+// the full integral image is never stored.
+class AdaptiveThresholdBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& image;
+	cv::Mat& binary;
+	int halfSize;
+	const int* scaledThreshold; // (p+threshold+1)*area for each gray level p
+
+  public:
+
+	AdaptiveThresholdBody(const cv::Mat& image, cv::Mat& binary, int halfSize, const int* scaledThreshold)
+		: image(image), binary(binary), halfSize(halfSize), scaledThreshold(scaledThreshold) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nl= image.rows;
+		int nc= image.cols;
+		int blockSize= 2*halfSize+1;
+
+		// vertical sums over the block, one per column
+		std::vector<int> columnSums(nc,0);
+		// integral of the column sums along the row (border replicated)
+		std::vector<int> rowIntegral(nc+blockSize,0);
+
+		// initial column sums for the first row of the band
+		for (int k= -halfSize; k<=halfSize; k++) {
+
+			const uchar* data= image.ptr<uchar>(clampRow(range.start+k,nl));
+			for (int i=0; i<nc; i++)
+				columnSums[i]+= data[i];
+		}
+
+		for (int j=range.start; j<range.end; j++) {
+
+			// slide the column sums one row down
+			if (j>range.start) {
+
+				updateColumnSums(&columnSums[0],
+					             image.ptr<uchar>(clampRow(j+halfSize,nl)),   // entering row
+					             image.ptr<uchar>(clampRow(j-halfSize-1,nl)), // leaving row
+					             nc);
+			}
+
+			// integral along the row, replicating the first and last columns
+			int* integ= &rowIntegral[0];
+			int sum= 0;
+			for (int i=0; i<halfSize; i++) {
+				sum+= columnSums[0];
+				integ[i+1]= sum;
+			}
+			for (int i=0; i<nc; i++) {
+				sum+= columnSums[i];
+				integ[halfSize+i+1]= sum;
+			}
+			for (int i=0; i<halfSize; i++) {
+				sum+= columnSums[nc-1];
+				integ[halfSize+nc+i+1]= sum;
+			}
+
+			// apply adaptive threshold:
+			// p < sum/area - threshold  <=>  sum >= (p+threshold+1)*area
+			// so no division is needed
+			const uchar* data= image.ptr<uchar>(j);
+			uchar* output= binary.ptr<uchar>(j);
+			for (int i=0; i<nc; i++) {
+
+				int blockSum= integ[i+blockSize]-integ[i];
+				output[i]= blockSum>=scaledThreshold[data[i]] ? 0 : 255;
+			}
+		}
+	}
+
+  private:
+
+	static int clampRow(int j, int nl) {
+
+		return j<0 ? 0 : (j>=nl ? nl-1 : j);
+	}
+
+	// columnSums[i] += in[i] - out[i]
+	static void updateColumnSums(int* columnSums, const uchar* in, const uchar* out, int nc) {
+
+		int i=0;
+#if CV_SIMD128
+		for (; i<=nc-16; i+=16) {
+
+			// widen 16 pixels to 16-bit differences
+			cv::v_uint16x8 in0, in1, out0, out1;
+			cv::v_expand(cv::v_load(in+i),in0,in1);
+			cv::v_expand(cv::v_load(out+i),out0,out1);
+			cv::v_int16x8 diff0= cv::v_reinterpret_as_s16(in0)-cv::v_reinterpret_as_s16(out0);
+			cv::v_int16x8 diff1= cv::v_reinterpret_as_s16(in1)-cv::v_reinterpret_as_s16(out1);
+
+			// then to 32-bit and accumulate
+			cv::v_int32x4 d0, d1, d2, d3;
+			cv::v_expand(diff0,d0,d1);
+			cv::v_expand(diff1,d2,d3);
+			cv::v_store(columnSums+i,   cv::v_load(columnSums+i)+d0);
+			cv::v_store(columnSums+i+4, cv::v_load(columnSums+i+4)+d1);
+			cv::v_store(columnSums+i+8, cv::v_load(columnSums+i+8)+d2);
+			cv::v_store(columnSums+i+12,cv::v_load(columnSums+i+12)+d3);
+		}
+#endif
+		for (; i<nc; i++)
+			columnSums[i]+= in[i]-out[i];
+	}
+};
+
+// Adaptive thresholding on the mean of a square neighborhood.
+// A pixel is set to 0 if it is darker than (mean - threshold), 255 otherwise.
+// Borders are replicated so that every pixel is thresholded.
+class AdaptiveThresholder {
+
+  private:
+
+	  int blockSize; // size of the neighborhood (odd)
+	  int threshold; // pixel will be compared to (mean-threshold)
+	  int nBands;    // number of row bands processed in parallel (-1 for default)
+
+  public:
+
+	  AdaptiveThresholder() : blockSize(21), threshold(10), nBands(-1) {}
+
+	  // Sets the size of the neighborhood.
+	  // Even sizes are rounded up to the next odd value.
+	  void setBlockSize(int size) {
+
+		  if (size<1)
+			  size= 1;
+		  blockSize= size|1;
+	  }
+
+	  // Gets the size of the neighborhood
+	  int getBlockSize() const {
+
+		  return blockSize;
+	  }
+
+	  // Sets the threshold subtracted from the mean
+	  void setThreshold(int t) {
+
+		  threshold= t;
+	  }
+
+	  // Gets the threshold subtracted from the mean
+	  int getThreshold() const {
+
+		  return threshold;
+	  }
+
+	  // Sets the number of row bands (-1 lets OpenCV decide)
+	  void setNumberOfBands(int n) {
+
+		  nBands= n;
+	  }
+
+	  // Gets the number of row bands
+	  int getNumberOfBands() const {
+
+		  return nBands;
+	  }
+
+	  // Thresholds a gray-level image
+	  void process(const cv::Mat& image, cv::Mat& binary) const {
+
+		  CV_Assert(image.type()==CV_8UC1);
+		  CV_Assert(image.data!=binary.data); // cannot be done in-place
+
+		  binary.create(image.rows,image.cols,CV_8U);
+
+		  // threshold on the block sum for each gray level
+		  int area= blockSize*blockSize;
+		  int scaledThreshold[256];
+		  for (int p=0; p<256; p++)
+			  scaledThreshold[p]= (p+threshold+1)*area;
+
+		  AdaptiveThresholdBody body(image,binary,blockSize/2,scaledThreshold);
+		  cv::parallel_for_(cv::Range(0,image.rows),body,nBands);
+	  }
+
+	  cv::Mat process(const cv::Mat& image) const {
+
+		  cv::Mat binary;
+		  process(image,binary);
+
+		  return binary;
+	  }
+};
+
+#endif
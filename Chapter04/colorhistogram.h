@@ -22,6 +22,8 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2\core\core.hpp>
 #include <opencv2\imgproc\imgproc.hpp>
 
+#include "packedHistogram.h"
+
 class ColorHistogram {
 
   private:
@@ -109,6 +111,16 @@ class ColorHistogram {
 		return hist;
 	}
 
+	// Computes the histogram in packed sparse form.
+	PackedHistogram getPackedHistogram(const cv::Mat &image) {
+
+		// BGR color histogram
+		PackedHistogram hist(histSize[0]);
+		hist.build(image);
+
+		return hist;
+	}
+
 	// Computes the 1D Hue histogram.
 	// BGR source image is converted to HSV
 	// Pixels with low saturation are ignored
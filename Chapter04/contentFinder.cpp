@@ -112,6 +112,29 @@ int main()
 	cv::namedWindow("Result color (2)");
 	cv::imshow("Result color (2)",result2);
 
+	// Compare the sparse histogram containers
+	// with 256x256x256 bins (build + back-projection)
+	hc.setSize(256);
+
+	int64 time= cv::getTickCount();
+	cv::SparseMat sparseHist= hc.getSparseHistogram(imageROI);
+	finder.setHistogram(sparseHist);
+	result2= finder.find(color2);
+	time= cv::getTickCount()-time;
+	std::cout << "time (SparseMat)= " << time << std::endl;
+
+	time= cv::getTickCount();
+	PackedHistogram packedHist= hc.getPackedHistogram(imageROI);
+	packedHist.normalize(); // L2 norm, as in ContentFinder
+	packedHist.backProject(color2,result2);
+	cv::threshold(result2, result2, 255.0*finder.getThreshold(), 255.0, cv::THRESH_BINARY);
+	time= cv::getTickCount()-time;
+	std::cout << "time (PackedHistogram)= " << time << std::endl;
+	std::cout << "non-empty bins= " << packedHist.nonZeroCount() << std::endl;
+
+	cv::namedWindow("Result color (packed)");
+	cv::imshow("Result color (packed)",result2);
+
 	// Get ab color histogram
 	hc.setSize(256); // 256x256
 	cv::Mat colorhist= hc.getabHistogram(imageROI);
@@ -36,21 +36,87 @@ class ContentFinder {
 	cv::SparseMat shistogram;  // or not
 	bool isSparse;
 
+	// compiled histogram (see compile)
+	int compiledDims;          // 0 if the histogram is not compiled
+	int compiledSize;          // total number of bins
+	cv::Mat binValues;         // back-projected value of each bin (1 x compiledSize, CV_8U)
+	cv::Mat lookUp;            // bin values after thresholding
+	cv::Mat binOffsets;        // offset of each pixel value in the table, one row per dimension (CV_32S)
+	int hueDivision[256];      // fixed-point 180/(6*diff) used by the BGR to hue conversion
+
+	// Gets the number of bins of each histogram dimension
+	int getHistogramSizes(int* sizes) {
+
+		if (isSparse) {
+
+			for (int i=0; i<shistogram.dims(); i++)
+				sizes[i]= shistogram.size(i);
+
+			return shistogram.dims();
+		}
+
+		// a 1D histogram is a N x 1 matrix
+		if (histogram.dims==2 && histogram.cols==1) {
+
+			sizes[0]= histogram.rows;
+			return 1;
+		}
+
+		for (int i=0; i<histogram.dims; i++)
+			sizes[i]= histogram.size[i];
+
+		return histogram.dims;
+	}
+
+	// Applies the current threshold to the compiled bin values
+	void updateLookUp() {
+
+		if (compiledDims==0)
+			return;
+
+		lookUp.create(1,compiledSize,CV_8U);
+		const uchar* value= binValues.ptr<uchar>(0);
+		uchar* output= lookUp.ptr<uchar>(0);
+
+		// same rule as cv::threshold on a 8-bit image
+		int ithreshold= cvFloor(255.0*threshold);
+		for (int k=0; k<compiledSize; k++) {
+
+			if (threshold>0.0)
+				output[k]= value[k]>ithreshold ? 255 : 0;
+			else
+				output[k]= value[k];
+		}
+	}
+
+	// Gets the back-projected value of a table offset
+	uchar getCompiledValue(int offset, const uchar* table) const {
+
+		// out-of-range values have an offset beyond the table
+		return offset<compiledSize ? table[offset] : 0;
+	}
+
   public:
 
-	ContentFinder() : threshold(0.1f), isSparse(false) {
+	ContentFinder() : threshold(0.1f), isSparse(false), compiledDims(0), compiledSize(0) {
 
 		// in this class,
 		// all channels have the same range
 		ranges[0]= hranges;  
 		ranges[1]= hranges; 
 		ranges[2]= hranges; 
+
+		// same fixed-point factors as cv::cvtColor for 8-bit HSV
+		hueDivision[0]= 0;
+		for (int i=1; i<256; i++)
+			hueDivision[i]= cv::saturate_cast<int>((180<<12)/(6.0*i));
 	}
    
 	// Sets the threshold on histogram values [0,1]
 	void setThreshold(float t) {
 
 		threshold= t;
+		updateLookUp();
 	}
 
 	// Gets the threshold
@@ -63,6 +129,7 @@ class ContentFinder {
 	void setHistogram(const cv::Mat& h) {
 
 		isSparse= false;
+		compiledDims= 0;
 		cv::normalize(h,histogram,1.0);
 	}
 
@@ -70,9 +137,79 @@ class ContentFinder {
 	void setHistogram(const cv::SparseMat& h) {
 
 		isSparse= true;
+		compiledDims= 0;
 		cv::normalize(h,shistogram,1.0,cv::NORM_L2);
 	}
 
+	// Compiles the reference histogram into a direct look-up table
+	// for 8-bit images with values in [minValue,maxValue[.
+	// Back-projection then becomes a single gather pass (see findCompiled).
+	void compile(float minValue=0.0f, float maxValue=256.0f) {
+
+		int sizes[3];
+		int dims= getHistogramSizes(sizes);
+		CV_Assert(dims>=1 && dims<=3);
+
+		compiledSize= 1;
+		for (int i=0; i<dims; i++)
+			compiledSize*= sizes[i];
+
+		// offset of each pixel value in each dimension,
+		// same binning as cv::calcBackProject
+		binOffsets.create(dims,256,CV_32S);
+		double a= 1.0/(maxValue-minValue);
+		int stride= 1;
+		for (int i=dims-1; i>=0; i--) {
+
+			int* offset= binOffsets.ptr<int>(i);
+			for (int v=0; v<256; v++) {
+
+				int bin= cvFloor(v*sizes[i]*a - minValue*sizes[i]*a);
+				if (v<minValue || v>=maxValue || bin<0 || bin>=sizes[i])
+					offset[v]= compiledSize; // out of range
+				else
+					offset[v]= bin*stride;
+			}
+
+			stride*= sizes[i];
+		}
+
+		// scale the bins such that a histogram value of 1 maps to 255
+		binValues= cv::Mat::zeros(1,compiledSize,CV_8U);
+		uchar* value= binValues.ptr<uchar>(0);
+
+		if (isSparse) {
+
+			cv::SparseMatConstIterator_<float> it= shistogram.begin<float>();
+			cv::SparseMatConstIterator_<float> itend= shistogram.end<float>();
+			for (; it!=itend; ++it) {
+
+				const cv::SparseMat::Node* node= it.node();
+				int k= 0;
+				for (int i=0; i<dims; i++)
+					k= k*sizes[i]+node->idx[i];
+
+				value[k]= cv::saturate_cast<uchar>(*it*255.0);
+			}
+
+		} else {
+
+			cv::Mat h= histogram.isContinuous() ? histogram : histogram.clone();
+			const float* bin= h.ptr<float>(0);
+			for (int k=0; k<compiledSize; k++)
+				value[k]= cv::saturate_cast<uchar>(bin[k]*255.0);
+		}
+
+		compiledDims= dims;
+		updateLookUp();
+	}
+
+	// Checks if the histogram has been compiled
+	bool isCompiled() const {
+
+		return compiledDims>0;
+	}
+
 	// Simplified version in which
 	// all channels used, with range [0,256[
 	cv::Mat find(const cv::Mat& image) {
@@ -132,6 +269,107 @@ class ContentFinder {
 		return result;
 	}
 
+	// Finds the pixels belonging to the compiled histogram
+	// the image must be 8-bit with values in the range given to compile
+	cv::Mat findCompiled(const cv::Mat& image, const int *channels) {
+
+		cv::Mat result;
+		findCompiled(image, channels, result);
+
+		return result;
+	}
+
+	// Same as above but writes into the result image
+	// (no allocation if it already has the right size)
+	void findCompiled(const cv::Mat& image, const int *channels, cv::Mat& result) {
+
+		CV_Assert(compiledDims>0 && image.depth()==CV_8U);
+
+		result.create(image.rows,image.cols,CV_8U);
+		int nc= image.channels();
+		const uchar* table= lookUp.ptr<uchar>(0);
+		const int* offset0= binOffsets.ptr<int>(0);
+		const int* offset1= binOffsets.ptr<int>(std::min(1,compiledDims-1));
+		const int* offset2= binOffsets.ptr<int>(std::min(2,compiledDims-1));
+
+		for (int j=0; j<image.rows; j++) {
+
+			const uchar* data= image.ptr<uchar>(j);
+			uchar* output= result.ptr<uchar>(j);
+
+			// one table gather per pixel
+			switch (compiledDims) {
+
+			  case 1:
+				for (int i=0; i<image.cols; i++, data+=nc)
+					output[i]= getCompiledValue(offset0[data[channels[0]]],table);
+				break;
+
+			  case 2:
+				for (int i=0; i<image.cols; i++, data+=nc)
+					output[i]= getCompiledValue(offset0[data[channels[0]]]+
+					                            offset1[data[channels[1]]],table);
+				break;
+
+			  case 3:
+				for (int i=0; i<image.cols; i++, data+=nc)
+					output[i]= getCompiledValue(offset0[data[channels[0]]]+
+					                            offset1[data[channels[1]]]+
+					                            offset2[data[channels[2]]],table);
+				break;
+			}
+		}
+	}
+
+	// Finds the pixels of a BGR image belonging to a compiled hue histogram
+	// the BGR to HSV conversion is fused with the back-projection
+	// (the histogram must have been compiled with range [0,180[)
+	cv::Mat findHue(const cv::Mat& image) {
+
+		cv::Mat result;
+		findHue(image, result);
+
+		return result;
+	}
+
+	// Same as above but writes into the result image
+	// (no allocation if it already has the right size)
+	void findHue(const cv::Mat& image, cv::Mat& result) {
+
+		CV_Assert(compiledDims==1 && image.type()==CV_8UC3);
+
+		result.create(image.rows,image.cols,CV_8U);
+		const uchar* table= lookUp.ptr<uchar>(0);
+		const int* offset= binOffsets.ptr<int>(0);
+
+		for (int j=0; j<image.rows; j++) {
+
+			const uchar* data= image.ptr<uchar>(j);
+			uchar* output= result.ptr<uchar>(j);
+
+			for (int i=0; i<image.cols; i++, data+=3) {
+
+				// hue computed exactly as cv::cvtColor does
+				int b= data[0], g= data[1], r= data[2];
+				int vmax= std::max(b,std::max(g,r));
+				int vmin= std::min(b,std::min(g,r));
+				int diff= vmax-vmin;
+				int h;
+				if (vmax==r)
+					h= g-b;
+				else if (vmax==g)
+					h= b-r+2*diff;
+				else
+					h= r-g+4*diff;
+				h= (h*hueDivision[diff]+(1<<11))>>12;
+				if (h<0)
+					h+= 180;
+
+				output[i]= getCompiledValue(offset[h],table);
+			}
+		}
+	}
+
 };
 
 
@@ -0,0 +1,233 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 4 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined CNORMALIZER
+#define CNORMALIZER
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "videoprocessor.h"
+
+// Normalizes the contrast of a video by histogram stretching
+// or equalization. The histogram is accumulated over frames
+// with an exponential decay and the lookup table is only
+// rebuilt when the statistics have moved enough.
+class ContrastNormalizer : public FrameProcessor {
+
+  public:
+
+	  enum Mode { STRETCH, EQUALIZE };
+
+  private:
+
+	  Mode mode;
+	  double decay;        // weight of the current frame in the histogram
+	  int sampling;        // one pixel out of sampling x sampling is counted
+	  float percentile;    // fraction of pixels saturated on each side (STRETCH)
+	  int tolerance;       // change in gray levels triggering a new lookup table
+
+	  std::vector<double> histogram; // decayed normalized histogram
+	  bool initialized;
+
+	  cv::Mat lookup;      // current lookup table (1x256 uchar)
+	  int imin, imax;      // current stretching bounds
+	  long lutUpdates;     // number of times the lookup table was rebuilt
+
+	  cv::Mat gray;        // conversion buffer for color frames
+
+	  // Accumulates a sampled histogram of the image
+	  void updateHistogram(const cv::Mat& image) {
+
+		  int counts[256]= { 0 };
+		  int n= 0;
+		  for (int j=sampling/2; j<image.rows; j+=sampling) {
+
+			  const uchar* data= image.ptr<uchar>(j);
+			  for (int i=sampling/2; i<image.cols; i+=sampling, n++)
+				  counts[data[i]]++;
+		  }
+
+		  if (n==0)
+			  return;
+
+		  // first frame initializes the histogram
+		  double a= initialized ? decay : 1.0;
+		  for (int i=0; i<256; i++)
+			  histogram[i]= (1.0-a)*histogram[i] + a*counts[i]/n;
+
+		  initialized= true;
+	  }
+
+	  // Rebuilds the stretching table if the percentile bounds moved
+	  void updateStretch() {
+
+		  // find left extremity of the histogram
+		  int low= 0;
+		  for (double count=0.0; low < 255; low++) {
+			  // fraction of pixels at low and below must be > percentile
+			  if ((count+=histogram[low]) >= percentile)
+				  break;
+		  }
+
+		  // find right extremity of the histogram
+		  int high= 255;
+		  for (double count=0.0; high > 0; high--) {
+			  // fraction of pixels at high and above must be > percentile
+			  if ((count+=histogram[high]) >= percentile)
+				  break;
+		  }
+
+		  if (high<=low)
+			  return;
+
+		  if (lutUpdates>0 && std::abs(low-imin)<=tolerance && std::abs(high-imax)<=tolerance)
+			  return;
+
+		  imin= low;
+		  imax= high;
+
+		  uchar* table= lookup.ptr<uchar>(0);
+		  for (int i = 0; i<256; i++) {
+
+			  if (i < imin) table[i] = 0;
+			  else if (i > imax) table[i] = 255;
+			  else table[i] = cvRound(255.0*(i - imin) / (imax - imin));
+		  }
+
+		  lutUpdates++;
+	  }
+
+	  // Rebuilds the equalization table if it moved by more than the tolerance
+	  void updateEqualize() {
+
+		  uchar candidate[256];
+		  int maxChange= 0;
+		  double cumulative= 0.0;
+		  const uchar* table= lookup.ptr<uchar>(0);
+		  for (int i = 0; i<256; i++) {
+
+			  cumulative+= histogram[i];
+			  candidate[i]= cv::saturate_cast<uchar>(255.0*cumulative);
+			  maxChange= std::max(maxChange, std::abs(candidate[i]-table[i]));
+		  }
+
+		  if (lutUpdates>0 && maxChange<=tolerance)
+			  return;
+
+		  std::copy(candidate, candidate+256, lookup.ptr<uchar>(0));
+		  lutUpdates++;
+	  }
+
+  public:
+
+	  ContrastNormalizer(Mode mode=STRETCH) : mode(mode), decay(0.1), sampling(4),
+		  percentile(0.01f), tolerance(2), histogram(256,0.0), initialized(false),
+		  imin(0), imax(255), lutUpdates(0) {
+
+		  lookup.create(1,256,CV_8U);
+		  reset();
+	  }
+
+	  // Restarts the statistics (e.g. on a scene cut)
+	  void reset() {
+
+		  std::fill(histogram.begin(),histogram.end(),0.0);
+		  initialized= false;
+		  imin= 0;
+		  imax= 255;
+		  lutUpdates= 0;
+
+		  // identity until the first frame
+		  uchar* table= lookup.ptr<uchar>(0);
+		  for (int i = 0; i<256; i++)
+			  table[i]= static_cast<uchar>(i);
+	  }
+
+	  // Sets the weight of the current frame in the histogram, in ]0,1]
+	  void setDecay(double d) {
+
+		  decay= d;
+	  }
+
+	  // Sets the sampling step (1 means every pixel)
+	  void setSampling(int step) {
+
+		  sampling= step<1 ? 1 : step;
+	  }
+
+	  // Sets the fraction of pixels saturated on each side (STRETCH mode)
+	  void setPercentile(float p) {
+
+		  percentile= p;
+	  }
+
+	  // Sets the change, in gray levels, needed to rebuild the lookup table
+	  void setTolerance(int t) {
+
+		  tolerance= t;
+	  }
+
+	  // Gets the current lookup table
+	  cv::Mat getLookUpTable() const {
+
+		  return lookup;
+	  }
+
+	  // Gets the number of times the lookup table was rebuilt
+	  long getNumberOfUpdates() const {
+
+		  return lutUpdates;
+	  }
+
+	  // Normalizes a gray-level image
+	  void normalize(const cv::Mat& image, cv::Mat& result) {
+
+		  CV_Assert(image.type()==CV_8UC1);
+
+		  updateHistogram(image);
+
+		  if (mode==STRETCH)
+			  updateStretch();
+		  else
+			  updateEqualize();
+
+		  // single lookup pass
+		  cv::LUT(image,lookup,result);
+	  }
+
+	  // callback processing method
+	  void process(cv::Mat &frame, cv::Mat &output) {
+
+		  if (frame.channels()==3) {
+
+			  cv::cvtColor(frame,gray,cv::COLOR_BGR2GRAY);
+			  normalize(gray,output);
+
+		  } else {
+
+			  normalize(frame,output);
+		  }
+	  }
+};
+
+#endif
@@ -85,6 +85,14 @@ int main()
 	cv::namedWindow("Backprojection on second image");
 	cv::imshow("Backprojection on second image",result);
 
+	// Same back-projection using the compiled histogram
+	// the HSV conversion is done in the same pass
+	finder.compile(0.0f,180.0f);
+	cv::Mat compiledResult= finder.findHue(image);
+
+	cv::namedWindow("Compiled backprojection on second image");
+	cv::imshow("Compiled backprojection on second image",compiledResult);
+
 	// initial window position
 	cv::rectangle(image, rect, cv::Scalar(0,0,255));
 
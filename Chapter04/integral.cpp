@@ -22,6 +22,7 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "integral.h"
+#include "adaptiveThresholder.h"
 
 int main()
 {
@@ -153,5 +154,20 @@ int main()
 	cv::namedWindow("Adaptive Threshold (filtered)");
 	cv::imshow("Adaptive Threshold (filtered)",binaryFiltered);
 
+	// adaptive threshold using a streaming integral
+	// computed over parallel bands of rows
+	AdaptiveThresholder thresholder;
+	thresholder.setBlockSize(blockSize);
+	thresholder.setThreshold(threshold);
+
+	time= cv::getTickCount();
+	cv::Mat binaryStreamed= thresholder.process(image);
+	time= cv::getTickCount()-time;
+
+	std::cout << "time streamed= " << time << std::endl; 
+
+	cv::namedWindow("Adaptive Threshold (streamed)");
+	cv::imshow("Adaptive Threshold (streamed)",binaryStreamed);
+
 	cv::waitKey();
 }
@@ -0,0 +1,204 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 4 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined MSTRACKER
+#define MSTRACKER
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "videoprocessor.h"
+#include "contentFinder.h"
+#include "colorhistogram.h"
+
+// Tracks a colored object in a video using
+// the back-projection of its hue histogram and mean shift.
+// The back-projection is only computed inside
+// a search region around the last known position.
+class MeanShiftTracker : public FrameProcessor {
+
+  private:
+
+	  ContentFinder finder;  // back-projects the compiled hue histogram
+	  cv::Rect window;       // current target window
+	  cv::RotatedRect box;   // oriented box (CamShift only)
+	  bool useCamShift;      // CamShift or plain mean shift
+	  int margin;            // search region expansion, in pixels on each side
+	  cv::TermCriteria criteria;
+
+	  // buffers reused from frame to frame
+	  cv::Mat backProjection; // frame-size buffer, only the search region is written
+
+	  cv::Rect searchRegion;  // search region used in the last frame
+	  int iterations;         // mean shift iterations in the last frame
+	  long totalIterations;   // over all processed frames
+	  long frames;            // number of processed frames
+
+  public:
+
+	  MeanShiftTracker() : useCamShift(false), margin(20),
+		  criteria(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS,
+		           10,  // iterate max 10 times
+		           1),  // or until the change in centroid position is less than 1px
+		  iterations(0), totalIterations(0), frames(0) {}
+
+	  // Sets the target to be tracked from its initial window.
+	  // Pixels with a saturation below minSaturation are
+	  // not used in the hue histogram.
+	  void setTarget(const cv::Mat& frame, const cv::Rect& rect, int minSaturation=65) {
+
+		  window= rect & cv::Rect(0,0,frame.cols,frame.rows);
+		  box= cv::RotatedRect();
+
+		  // compute and compile the hue histogram of the target
+		  ColorHistogram hc;
+		  hc.setSize(180);
+		  finder.setHistogram(hc.getHueHistogram(frame(window),minSaturation));
+		  finder.setThreshold(-1.0f); // no thresholding
+		  finder.compile(0.0f,180.0f);
+
+		  iterations= 0;
+		  totalIterations= 0;
+		  frames= 0;
+	  }
+
+	  // Uses CamShift instead of mean shift
+	  void setCamShift(bool flag) {
+
+		  useCamShift= flag;
+	  }
+
+	  // Sets the number of pixels added on each side of
+	  // the last window to obtain the search region
+	  void setMargin(int m) {
+
+		  margin= m;
+	  }
+
+	  // Gets the search margin
+	  int getMargin() const {
+
+		  return margin;
+	  }
+
+	  // Sets the mean shift stopping criteria
+	  void setTermCriteria(const cv::TermCriteria& c) {
+
+		  criteria= c;
+	  }
+
+	  // Gets the current target window
+	  cv::Rect getWindow() const {
+
+		  return window;
+	  }
+
+	  // Gets the oriented box found by CamShift
+	  cv::RotatedRect getBox() const {
+
+		  return box;
+	  }
+
+	  // Gets the search region used in the last frame
+	  cv::Rect getSearchRegion() const {
+
+		  return searchRegion;
+	  }
+
+	  // Gets the number of mean shift iterations in the last frame
+	  int getIterations() const {
+
+		  return iterations;
+	  }
+
+	  // Gets the average number of iterations per frame
+	  double getAverageIterations() const {
+
+		  return frames ? static_cast<double>(totalIterations)/frames : 0.0;
+	  }
+
+	  // Gets the back-projection of the last frame
+	  // (only the search region is valid)
+	  cv::Mat getBackProjection() const {
+
+		  return backProjection(searchRegion);
+	  }
+
+	  // Tracks the target in the current frame
+	  void track(const cv::Mat& frame) {
+
+		  CV_Assert(finder.isCompiled());
+
+		  // allocated once for the whole sequence
+		  backProjection.create(frame.rows,frame.cols,CV_8U);
+
+		  // expand the last window, clipped to the frame
+		  searchRegion= cv::Rect(window.x-margin, window.y-margin,
+			                     window.width+2*margin, window.height+2*margin)
+			            & cv::Rect(0,0,frame.cols,frame.rows);
+		  if (searchRegion.area()==0) {
+
+			  iterations= 0;
+			  return;
+		  }
+
+		  // back-project the hue histogram inside the search region only
+		  // (the ROI header has the right size, so no allocation occurs)
+		  cv::Mat projection= backProjection(searchRegion);
+		  finder.findHue(frame(searchRegion),projection);
+
+		  // mean shift in search region coordinates
+		  cv::Rect local(window.x-searchRegion.x, window.y-searchRegion.y,
+			             window.width, window.height);
+		  local&= cv::Rect(0,0,searchRegion.width,searchRegion.height);
+		  iterations= cv::meanShift(projection,local,criteria);
+
+		  if (useCamShift) {
+
+			  // cv::CamShift does not report its iterations;
+			  // started from the converged window it needs a single one
+			  // to compute the oriented box and adapt the window size
+			  cv::TermCriteria once(cv::TermCriteria::MAX_ITER,1,criteria.epsilon);
+			  box= cv::CamShift(projection,local,once);
+			  box.center.x+= searchRegion.x;
+			  box.center.y+= searchRegion.y;
+			  iterations++;
+		  }
+
+		  // back to frame coordinates
+		  window= cv::Rect(local.x+searchRegion.x, local.y+searchRegion.y,
+			               local.width, local.height);
+
+		  totalIterations+= iterations;
+		  frames++;
+	  }
+
+	  // callback processing method
+	  void process(cv::Mat &frame, cv::Mat &output) {
+
+		  track(frame);
+
+		  // draw the search region and the target window
+		  frame.copyTo(output);
+		  cv::rectangle(output, searchRegion, cv::Scalar(255, 0, 0));
+		  cv::rectangle(output, window, cv::Scalar(0, 255, 0), 2);
+	  }
+};
+
+#endif
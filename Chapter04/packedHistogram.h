@@ -0,0 +1,330 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 4 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined PACKEDHISTOGRAM
+#define PACKEDHISTOGRAM
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Sparse 3D color histogram of BGR images.
+// The 3 bin indices are packed into one 32-bit key,
+// and the non-empty bins are kept in an open-addressing
+// hash table (linear probing) of keys and values.
+class PackedHistogram {
+
+  private:
+
+	int nBins;                     // number of bins per channel
+	unsigned char binOf[256];      // bin index of each channel value
+	std::vector<unsigned int> keys;
+	std::vector<float> values;
+	unsigned int slotMask;         // table capacity - 1 (capacity is a power of 2)
+	int shift;                     // 32 - log2(capacity)
+	size_t count;                  // number of non-empty bins
+
+	// Key marking an empty slot
+	static unsigned int emptyKey() {
+
+		return 0xFFFFFFFFu;
+	}
+
+	// Packed key of a BGR pixel
+	unsigned int getKey(const uchar* pixel) const {
+
+		return (binOf[pixel[0]]*nBins + binOf[pixel[1]])*nBins + binOf[pixel[2]];
+	}
+
+	// Multiplicative hashing of a key
+	unsigned int getSlot(unsigned int key) const {
+
+		return (key*2654435761u) >> shift;
+	}
+
+	// Allocates an empty table of the given capacity (a power of 2)
+	void allocate(size_t capacity) {
+
+		keys.assign(capacity,emptyKey());
+		values.assign(capacity,0.0f);
+		slotMask= static_cast<unsigned int>(capacity-1);
+		shift= 32;
+		for (size_t c=capacity; c>1; c>>=1)
+			shift--;
+		count= 0;
+	}
+
+	// Doubles the table capacity
+	void grow() {
+
+		std::vector<unsigned int> oldKeys;
+		std::vector<float> oldValues;
+		oldKeys.swap(keys);
+		oldValues.swap(values);
+
+		allocate(oldKeys.size()*2);
+		for (size_t i=0; i<oldKeys.size(); i++)
+			if (oldKeys[i]!=emptyKey())
+				ref(oldKeys[i])= oldValues[i];
+	}
+
+  public:
+
+	PackedHistogram(int binsPerChannel=256) {
+
+		setSize(binsPerChannel);
+	}
+
+	// Sets the number of bins per channel (at most 256)
+	// and empties the histogram
+	void setSize(int binsPerChannel) {
+
+		CV_Assert(binsPerChannel>0 && binsPerChannel<=256);
+		nBins= binsPerChannel;
+
+		// same binning as cv::calcHist on the range [0,256[
+		for (int v=0; v<256; v++)
+			binOf[v]= static_cast<unsigned char>(v*nBins/256);
+
+		allocate(1024);
+	}
+
+	// Gets the number of bins per channel
+	int getSize() const {
+
+		return nBins;
+	}
+
+	// Gets the number of non-empty bins
+	size_t nonZeroCount() const {
+
+		return count;
+	}
+
+	// Gets a reference to the value of a bin,
+	// inserting an empty bin if required
+	float& ref(unsigned int key) {
+
+		// keep the load factor below 1/2
+		if (2*(count+1) > keys.size())
+			grow();
+
+		unsigned int slot= getSlot(key);
+		while (keys[slot]!=emptyKey() && keys[slot]!=key)
+			slot= (slot+1) & slotMask;
+
+		if (keys[slot]==emptyKey()) {
+
+			keys[slot]= key;
+			count++;
+		}
+
+		return values[slot];
+	}
+
+	// Gets the value of a bin (0 if empty)
+	float value(unsigned int key) const {
+
+		unsigned int slot= getSlot(key);
+		while (keys[slot]!=emptyKey()) {
+
+			if (keys[slot]==key)
+				return values[slot];
+			slot= (slot+1) & slotMask;
+		}
+
+		return 0.0f;
+	}
+
+	// Gets the value of the bin (b,g,r)
+	float value(int b, int g, int r) const {
+
+		return value(static_cast<unsigned int>((b*nBins + g)*nBins + r));
+	}
+
+	// Computes the histogram of a BGR image
+	// only pixels with a non-zero mask value are counted (if a mask is given)
+	void build(const cv::Mat& image, const cv::Mat& mask=cv::Mat()) {
+
+		CV_Assert(image.type()==CV_8UC3);
+		allocate(1024);
+
+		for (int j=0; j<image.rows; j++) {
+
+			const uchar* data= image.ptr<uchar>(j);
+			const uchar* maskData= mask.empty() ? 0 : mask.ptr<uchar>(j);
+
+			// consecutive pixels often fall into the same bin
+			unsigned int lastKey= emptyKey();
+			float* lastBin= 0;
+
+			for (int i=0; i<image.cols; i++, data+=3) {
+
+				if (maskData && !maskData[i])
+					continue;
+
+				unsigned int key= getKey(data);
+				if (key!=lastKey) {
+
+					// the table can only be resized by this call
+					lastKey= key;
+					lastBin= &ref(key);
+				}
+
+				(*lastBin)+= 1.0f;
+			}
+		}
+	}
+
+	// Normalizes the histogram such that its L2 norm is equal to norm
+	void normalize(double norm=1.0) {
+
+		double sum= 0.0;
+		for (size_t i=0; i<keys.size(); i++)
+			if (keys[i]!=emptyKey())
+				sum+= values[i]*values[i];
+
+		if (sum==0.0)
+			return;
+
+		float scale= static_cast<float>(norm/std::sqrt(sum));
+		for (size_t i=0; i<keys.size(); i++)
+			values[i]*= scale;
+	}
+
+	// Back-projects the histogram on a BGR image
+	// bin values are multiplied by scale and saturated to 8-bit
+	void backProject(const cv::Mat& image, cv::Mat& result, double scale=255.0) const {
+
+		CV_Assert(image.type()==CV_8UC3);
+		result.create(image.rows,image.cols,CV_8U);
+
+		for (int j=0; j<image.rows; j++) {
+
+			const uchar* data= image.ptr<uchar>(j);
+			uchar* output= result.ptr<uchar>(j);
+
+			unsigned int lastKey= emptyKey();
+			uchar lastValue= 0;
+
+			for (int i=0; i<image.cols; i++, data+=3) {
+
+				unsigned int key= getKey(data);
+				if (key!=lastKey) {
+
+					lastKey= key;
+					lastValue= cv::saturate_cast<uchar>(value(key)*scale);
+				}
+
+				output[i]= lastValue;
+			}
+		}
+	}
+
+	// Gets the non-empty bins sorted by key
+	void getBins(std::vector<int>& sortedKeys, std::vector<float>& sortedValues) const {
+
+		std::vector<std::pair<unsigned int,float> > bins;
+		bins.reserve(count);
+		for (size_t i=0; i<keys.size(); i++)
+			if (keys[i]!=emptyKey())
+				bins.push_back(std::make_pair(keys[i],values[i]));
+
+		std::sort(bins.begin(),bins.end());
+
+		sortedKeys.resize(bins.size());
+		sortedValues.resize(bins.size());
+		for (size_t i=0; i<bins.size(); i++) {
+
+			sortedKeys[i]= static_cast<int>(bins[i].first);
+			sortedValues[i]= bins[i].second;
+		}
+	}
+
+	// Converts to an OpenCV sparse histogram
+	cv::SparseMat getSparseMat() const {
+
+		int histSize[3]= { nBins, nBins, nBins };
+		cv::SparseMat hist(3,histSize,CV_32F);
+
+		for (size_t i=0; i<keys.size(); i++) {
+
+			if (keys[i]!=emptyKey()) {
+
+				int idx[3]= { static_cast<int>(keys[i]/(nBins*nBins)),
+				              static_cast<int>(keys[i]/nBins%nBins),
+				              static_cast<int>(keys[i]%nBins) };
+				hist.ref<float>(idx)= values[i];
+			}
+		}
+
+		return hist;
+	}
+
+	// Saves the histogram as a sorted array of (key,value)
+	bool save(const std::string& filename) const {
+
+		cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+		if (!fs.isOpened())
+			return false;
+
+		std::vector<int> sortedKeys;
+		std::vector<float> sortedValues;
+		getBins(sortedKeys,sortedValues);
+
+		fs << "bins" << nBins;
+		fs << "keys" << sortedKeys;
+		fs << "values" << sortedValues;
+
+		return true;
+	}
+
+	// Loads a histogram saved with save
+	bool load(const std::string& filename) {
+
+		cv::FileStorage fs(filename, cv::FileStorage::READ);
+		if (!fs.isOpened())
+			return false;
+
+		int bins;
+		std::vector<int> sortedKeys;
+		std::vector<float> sortedValues;
+		fs["bins"] >> bins;
+		fs["keys"] >> sortedKeys;
+		fs["values"] >> sortedValues;
+
+		if (bins<=0 || bins>256 || sortedKeys.size()!=sortedValues.size())
+			return false;
+		// every key must be a (b,g,r) bin, the empty key included
+		for (size_t i=0; i<sortedKeys.size(); i++)
+			if (sortedKeys[i]<0 || sortedKeys[i]>=bins*bins*bins)
+				return false;
+
+		setSize(bins);
+		for (size_t i=0; i<sortedKeys.size(); i++)
+			ref(static_cast<unsigned int>(sortedKeys[i]))= sortedValues[i];
+
+		return true;
+	}
+};
+
+#endif
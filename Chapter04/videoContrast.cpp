@@ -0,0 +1,66 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 4 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/highgui.hpp>
+
+#include "contrastNormalizer.h"
+
+int main()
+{
+	// generate the filenames of the image sequence
+	std::vector<std::string> imgs;
+	std::string prefix = "goose/goose";
+	std::string ext = ".bmp";
+
+	for (long i = 0; i < 317; i++) {
+
+		std::ostringstream ss; 
+		ss << prefix << std::setfill('0') << std::setw(3) << i << ext;
+		imgs.push_back(ss.str());
+	}
+
+	// Create the contrast normalizer
+	ContrastNormalizer normalizer(ContrastNormalizer::STRETCH);
+	normalizer.setPercentile(0.01f); // 1% of pixels saturated on each side
+	normalizer.setDecay(0.1);        // slowly varying statistics
+	normalizer.setSampling(4);       // 1 pixel out of 16 in the histogram
+	normalizer.setTolerance(2);      // rebuild if a bound moved by more than 2 levels
+
+	// Create video procesor instance
+	VideoProcessor processor;
+	processor.setInput(imgs);
+	processor.setFrameProcessor(&normalizer);
+	processor.displayInput("Input video");
+	processor.displayOutput("Normalized video");
+	processor.setDelay(50);
+
+	// Start the processing
+	processor.run();
+
+	std::cout << "frames= " << processor.getNumberOfProcessedFrames() << std::endl;
+	std::cout << "lookup table updates= " << normalizer.getNumberOfUpdates() << std::endl;
+
+	cv::waitKey();
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 4 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/highgui.hpp>
+
+#include "meanShiftTracker.h"
+
+int main()
+{
+	// generate the filenames of the image sequence
+	std::vector<std::string> imgs;
+	std::string prefix = "goose/goose";
+	std::string ext = ".bmp";
+
+	for (long i = 130; i < 317; i++) {
+
+		std::ostringstream ss; 
+		ss << prefix << std::setfill('0') << std::setw(3) << i << ext;
+		imgs.push_back(ss.str());
+	}
+
+	// Read first frame
+	cv::Mat image= cv::imread(imgs[0]);
+	if (!image.data)
+		return 0; 
+
+	// Specify the original target position
+	cv::Rect bb(290, 100, 65, 40);
+
+	// Create the tracker from the target's hue histogram
+	MeanShiftTracker tracker;
+	tracker.setTarget(image, bb);
+	tracker.setMargin(20); // only back-project around the last position
+
+	// Create video procesor instance
+	VideoProcessor processor;
+	processor.setInput(imgs);
+	processor.setFrameProcessor(&tracker);
+	processor.displayOutput("Tracked object");
+	processor.setDelay(50);
+
+	// Start the tracking
+	int64 time= cv::getTickCount();
+	processor.run();
+	time= cv::getTickCount()-time;
+
+	std::cout << "time= " << time << std::endl;
+	std::cout << "iterations per frame= " << tracker.getAverageIterations() << std::endl;
+
+	cv::waitKey();
+	return 0;
+}
@@ -0,0 +1,467 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 5 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined BINMORPHO
+#define BINMORPHO
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// A binary image packed at 1 bit per pixel.
+// Pixel x of a row is bit x%64 of word x/64.
+// Padding bits at the end of a row are always 0.
+class PackedMask {
+
+	int rows, cols;
+	int words; // number of 64-bit words per row
+	std::vector<uint64> bits;
+
+  public:
+
+	PackedMask() : rows(0), cols(0), words(0) {}
+
+	// Allocates a mask (content is undefined)
+	void create(int r, int c) {
+
+		rows= r;
+		cols= c;
+		words= (c+63)/64;
+		bits.resize(static_cast<size_t>(rows)*words);
+	}
+
+	int getRows() const { return rows; }
+	int getCols() const { return cols; }
+	int getWordsPerRow() const { return words; }
+
+	// Gets the address of row j
+	uint64* ptr(int j) {
+
+		return &bits[static_cast<size_t>(j)*words];
+	}
+
+	const uint64* ptr(int j) const {
+
+		return &bits[static_cast<size_t>(j)*words];
+	}
+
+	// Gets the mask of the valid bits of the last word of a row
+	uint64 getLastWordMask() const {
+
+		return cols%64 ? (~static_cast<uint64>(0))>>(64-cols%64) : ~static_cast<uint64>(0);
+	}
+
+	// Packs a 8-bit image, non-zero pixels are set to 1
+	void pack(const cv::Mat& image) {
+
+		CV_Assert(image.type()==CV_8UC1);
+		create(image.rows,image.cols);
+
+		for (int j=0; j<rows; j++) {
+
+			const uchar* data= image.ptr<uchar>(j);
+			uint64* output= ptr(j);
+
+			int i=0;
+			int w=0;
+#if CV_SIMD128
+			cv::v_uint8x16 zero= cv::v_setzero_u8();
+			for (; i<=cols-64; i+=64, w++) {
+
+				// one bit per byte from the sign of (pixel != 0)
+				uint64 m0= cv::v_signmask(cv::v_load(data+i)!=zero);
+				uint64 m1= cv::v_signmask(cv::v_load(data+i+16)!=zero);
+				uint64 m2= cv::v_signmask(cv::v_load(data+i+32)!=zero);
+				uint64 m3= cv::v_signmask(cv::v_load(data+i+48)!=zero);
+				output[w]= m0 | (m1<<16) | (m2<<32) | (m3<<48);
+			}
+#endif
+			for (; w<words; w++) {
+
+				uint64 word= 0;
+				int n= std::min(64,cols-w*64);
+				for (int b=0; b<n; b++, i++)
+					if (data[i])
+						word|= static_cast<uint64>(1)<<b;
+				output[w]= word;
+			}
+		}
+	}
+
+	// Unpacks to a 8-bit image, 1 bits are set to value
+	void unpack(cv::Mat& image, uchar value=255) const {
+
+		image.create(rows,cols,CV_8U);
+
+		// 8 bytes of 0 or value for each of the 256 bit patterns
+		uint64 table[256];
+		for (int b=0; b<256; b++) {
+
+			uint64 bytes= 0;
+			for (int i=0; i<8; i++)
+				if (b & (1<<i))
+					bytes|= static_cast<uint64>(value)<<(8*i);
+			table[b]= bytes;
+		}
+
+		for (int j=0; j<rows; j++) {
+
+			const uint64* input= ptr(j);
+			uchar* data= image.ptr<uchar>(j);
+
+			// 8 pixels at a time
+			int i=0;
+			for (; i<=cols-8; i+=8) {
+
+				uint64 bytes= table[(input[i/64]>>(i%64)) & 0xFF];
+				memcpy(data+i,&bytes,8);
+			}
+
+			for (; i<cols; i++)
+				data[i]= (input[i/64]>>(i%64)) & 1 ? value : 0;
+		}
+	}
+
+	// Packs a 8-bit image
+	static PackedMask fromMat(const cv::Mat& image) {
+
+		PackedMask mask;
+		mask.pack(image);
+
+		return mask;
+	}
+};
+
+// Horizontal erosion (AND) or dilation (OR) of packed rows
+// over a window of width pixels starting at x-anchor.
+class PackedRowFilter : public cv::ParallelLoopBody {
+
+	const PackedMask& src;
+	PackedMask& dst;
+	bool isErosion;
+	int width, anchor;
+
+	// Reads the 64 bits starting at bit position pos
+	static uint64 readBits(const uint64* buffer, int pos) {
+
+		int w= pos/64, b= pos%64;
+		return b ? (buffer[w]>>b) | (buffer[w+1]<<(64-b)) : buffer[w];
+	}
+
+  public:
+
+	PackedRowFilter(const PackedMask& src, PackedMask& dst, bool isErosion, int width, int anchor)
+		: src(src), dst(dst), isErosion(isErosion), width(width), anchor(anchor) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int words= src.getWordsPerRow();
+		int frontGuard= width/64+2;
+		int n= frontGuard+words+2*(width/64)+4;
+		std::vector<uint64> buffer(n);
+		uint64* buf= &buffer[0];
+
+		// pixels outside the image do not change the result
+		uint64 fill= isErosion ? ~static_cast<uint64>(0) : 0;
+		uint64 lastMask= src.getLastWordMask();
+
+		for (int j=range.start; j<range.end; j++) {
+
+			std::fill(buffer.begin(),buffer.end(),fill);
+			std::copy(src.ptr(j),src.ptr(j)+words,buf+frontGuard);
+			if (isErosion)
+				buf[frontGuard+words-1]|= ~lastMask;
+
+			// buf[x] becomes the AND (or OR) of the length pixels starting at x
+			// the length is doubled at each step
+			int length= 1;
+			while (2*length<=width) {
+
+				combine(buf,n,length);
+				length*= 2;
+			}
+			if (length<width)
+				combine(buf,n,width-length);
+
+			// output pixel x is the window starting at x-anchor
+			uint64* output= dst.ptr(j);
+			for (int w=0; w<words; w++)
+				output[w]= readBits(buf,(frontGuard+w)*64-anchor);
+			output[words-1]&= lastMask;
+		}
+	}
+
+  private:
+
+	// buf[x] = buf[x] op buf[x+shift] (in place, front to back)
+	void combine(uint64* buf, int n, int shift) const {
+
+		int ws= shift/64, bs= shift%64;
+		int limit= n-ws-1;
+
+		if (isErosion) {
+			for (int w=0; w<limit; w++)
+				buf[w]&= bs ? (buf[w+ws]>>bs) | (buf[w+ws+1]<<(64-bs)) : buf[w+ws];
+		} else {
+			for (int w=0; w<limit; w++)
+				buf[w]|= bs ? (buf[w+ws]>>bs) | (buf[w+ws+1]<<(64-bs)) : buf[w+ws];
+		}
+	}
+};
+
+// Vertical erosion (AND) or dilation (OR) of packed rows
+// over a window of height rows starting at y-anchor.
+// Each call processes a range of word columns.
+class PackedColumnFilter : public cv::ParallelLoopBody {
+
+	const PackedMask& src;
+	PackedMask& dst;
+	bool isErosion;
+	int height, anchor;
+
+  public:
+
+	PackedColumnFilter(const PackedMask& src, PackedMask& dst, bool isErosion, int height, int anchor)
+		: src(src), dst(dst), isErosion(isErosion), height(height), anchor(anchor) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int rows= src.getRows();
+		int nw= range.end-range.start;
+		int n= height+rows+2*height; // guard rows before and after
+		std::vector<uint64> buffer(static_cast<size_t>(n)*nw,
+		                           isErosion ? ~static_cast<uint64>(0) : 0);
+		uint64* buf= &buffer[0];
+
+		for (int j=0; j<rows; j++)
+			std::copy(src.ptr(j)+range.start,src.ptr(j)+range.end,buf+static_cast<size_t>(height+j)*nw);
+
+		// row r becomes the AND (or OR) of the length rows starting at r
+		int length= 1;
+		while (2*length<=height) {
+
+			combine(buf,n,nw,length);
+			length*= 2;
+		}
+		if (length<height)
+			combine(buf,n,nw,height-length);
+
+		// output row y is the window starting at y-anchor
+		for (int j=0; j<rows; j++) {
+
+			const uint64* input= buf+static_cast<size_t>(height+j-anchor)*nw;
+			std::copy(input,input+nw,dst.ptr(j)+range.start);
+		}
+	}
+
+  private:
+
+	// row[r] = row[r] op row[r+shift] (in place, top to bottom)
+	void combine(uint64* buf, int n, int nw, int shift) const {
+
+		for (int r=0; r<n-shift; r++) {
+
+			uint64* row= buf+static_cast<size_t>(r)*nw;
+			const uint64* other= row+static_cast<size_t>(shift)*nw;
+
+			int w=0;
+#if CV_SIMD128
+			if (isErosion) {
+				for (; w<=nw-2; w+=2)
+					cv::v_store(row+w,cv::v_load(row+w) & cv::v_load(other+w));
+			} else {
+				for (; w<=nw-2; w+=2)
+					cv::v_store(row+w,cv::v_load(row+w) | cv::v_load(other+w));
+			}
+#endif
+			for (; w<nw; w++)
+				row[w]= isErosion ? row[w] & other[w] : row[w] | other[w];
+		}
+	}
+};
+
+// Morphological operators on packed binary images.
+// The structuring element is a rectangle or a cross of any size,
+// anchored at its center; results are the same as
+// cv::erode, cv::dilate and cv::morphologyEx with default borders.
+class BinaryMorphology {
+
+  private:
+
+	  int shape;      // cv::MORPH_RECT or cv::MORPH_CROSS
+	  cv::Size size;  // size of the structuring element
+
+	  // buffers reused between calls
+	  PackedMask horizontal, vertical, tmp;
+
+	  // Rectangle of width x height with the given anchor
+	  void filterRect(const PackedMask& src, PackedMask& dst, bool isErosion,
+		              int width, int height, int ax, int ay) {
+
+		  dst.create(src.getRows(),src.getCols());
+
+		  if (width>1 && height>1) {
+
+			  horizontal.create(src.getRows(),src.getCols());
+			  cv::parallel_for_(cv::Range(0,src.getRows()),
+				                PackedRowFilter(src,horizontal,isErosion,width,ax));
+			  cv::parallel_for_(cv::Range(0,src.getWordsPerRow()),
+				                PackedColumnFilter(horizontal,dst,isErosion,height,ay));
+
+		  } else if (width>1) {
+
+			  cv::parallel_for_(cv::Range(0,src.getRows()),
+				                PackedRowFilter(src,dst,isErosion,width,ax));
+
+		  } else if (height>1) {
+
+			  cv::parallel_for_(cv::Range(0,src.getWordsPerRow()),
+				                PackedColumnFilter(src,dst,isErosion,height,ay));
+
+		  } else {
+
+			  dst= src;
+		  }
+	  }
+
+	  // One erosion or dilation with the structuring element
+	  void filter(const PackedMask& src, PackedMask& dst, bool isErosion, int iterations) {
+
+		  int ax= size.width/2, ay= size.height/2;
+
+		  if (shape==cv::MORPH_RECT) {
+
+			  // n iterations with a rectangle are one pass with a larger rectangle
+			  filterRect(src,dst,isErosion,
+				         size.width+(iterations-1)*(size.width-1),
+				         size.height+(iterations-1)*(size.height-1),
+				         ax*iterations,ay*iterations);
+			  return;
+		  }
+
+		  // cross: min (or max) over the horizontal and the vertical line
+		  const PackedMask* input= &src;
+		  for (int it=0; it<iterations; it++) {
+
+			  filterRect(*input,horizontal,isErosion,size.width,1,ax,0);
+			  filterRect(*input,vertical,isErosion,1,size.height,0,ay);
+
+			  dst.create(src.getRows(),src.getCols());
+			  for (int j=0; j<src.getRows(); j++) {
+
+				  const uint64* h= horizontal.ptr(j);
+				  const uint64* v= vertical.ptr(j);
+				  uint64* output= dst.ptr(j);
+				  for (int w=0; w<src.getWordsPerRow(); w++)
+					  output[w]= isErosion ? h[w] & v[w] : h[w] | v[w];
+			  }
+
+			  tmp= dst;
+			  input= &tmp;
+		  }
+	  }
+
+  public:
+
+	  BinaryMorphology(int shape=cv::MORPH_RECT, cv::Size size=cv::Size(3,3))
+		  : shape(shape), size(size) {}
+
+	  // Sets the structuring element (cv::MORPH_RECT or cv::MORPH_CROSS)
+	  void setElement(int s, cv::Size sz) {
+
+		  CV_Assert(s==cv::MORPH_RECT || s==cv::MORPH_CROSS);
+		  CV_Assert(sz.width>0 && sz.height>0);
+		  shape= s;
+		  size= sz;
+	  }
+
+	  void erode(const PackedMask& src, PackedMask& dst, int iterations=1) {
+
+		  filter(src,dst,true,iterations);
+	  }
+
+	  void dilate(const PackedMask& src, PackedMask& dst, int iterations=1) {
+
+		  filter(src,dst,false,iterations);
+	  }
+
+	  // Applies cv::MORPH_ERODE, DILATE, OPEN, CLOSE or GRADIENT
+	  void morphologyEx(const PackedMask& src, PackedMask& dst, int op, int iterations=1) {
+
+		  PackedMask first;
+
+		  switch (op) {
+
+			case cv::MORPH_ERODE:
+				erode(src,dst,iterations);
+				break;
+
+			case cv::MORPH_DILATE:
+				dilate(src,dst,iterations);
+				break;
+
+			case cv::MORPH_OPEN:
+				erode(src,first,iterations);
+				dilate(first,dst,iterations);
+				break;
+
+			case cv::MORPH_CLOSE:
+				dilate(src,first,iterations);
+				erode(first,dst,iterations);
+				break;
+
+			case cv::MORPH_GRADIENT:
+				{
+				// dilated and not eroded
+				PackedMask eroded;
+				erode(src,eroded,iterations);
+				dilate(src,dst,iterations);
+				for (int j=0; j<dst.getRows(); j++) {
+
+					uint64* output= dst.ptr(j);
+					const uint64* e= eroded.ptr(j);
+					for (int w=0; w<dst.getWordsPerRow(); w++)
+						output[w]&= ~e[w];
+				}
+				}
+				break;
+
+			default:
+				CV_Error(cv::Error::StsBadArg, "unsupported morphological operation");
+		  }
+	  }
+
+	  // Applies an operation on a binary 8-bit image (0 or 255)
+	  cv::Mat morphologyEx(const cv::Mat& image, int op, int iterations=1) {
+
+		  PackedMask src, dst;
+		  src.pack(image);
+		  morphologyEx(src,dst,op,iterations);
+
+		  cv::Mat result;
+		  dst.unpack(result);
+
+		  return result;
+	  }
+};
+
+#endif
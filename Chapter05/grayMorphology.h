@@ -0,0 +1,281 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 5 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined GRAYMORPHO
+#define GRAYMORPHO
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Running min (or max) along the columns of an 8-bit image
+// using the van Herk/Gil-Werman algorithm.
+// The padded columns are cut into blocks of the kernel length;
+// each output is the min of a suffix of one block and of a prefix
+// of the next block, so that the cost per pixel does not depend
+// on the kernel length.
+// Each task is one block of output rows over one strip of columns.
+class VHGWColumnFilter : public cv::ParallelLoopBody {
+
+	const cv::Mat& src;
+	cv::Mat& dst;
+	bool isErosion;
+	int length;      // kernel length
+	int anchor;      // kernel anchor
+	int rowBytes;    // bytes per row (all channels)
+	int stripWidth;  // bytes per strip
+	int nStrips;
+	std::vector<uchar> border; // neutral row (255 for erosion, 0 for dilation)
+
+	// Row q of the source padded with anchor neutral rows on top
+	const uchar* paddedRow(int q) const {
+
+		int j= q-anchor;
+		return (j>=0 && j<src.rows) ? src.ptr<uchar>(j) : &border[0];
+	}
+
+	// out[i] = min(a[i],b[i]) for erosion, max(a[i],b[i]) for dilation
+	void combine(const uchar* a, const uchar* b, uchar* out, int n) const {
+
+		int i=0;
+#if CV_SIMD128
+		if (isErosion) {
+			for (; i<=n-16; i+=16)
+				cv::v_store(out+i, cv::v_min(cv::v_load(a+i),cv::v_load(b+i)));
+		} else {
+			for (; i<=n-16; i+=16)
+				cv::v_store(out+i, cv::v_max(cv::v_load(a+i),cv::v_load(b+i)));
+		}
+#endif
+		if (isErosion) {
+			for (; i<n; i++)
+				out[i]= std::min(a[i],b[i]);
+		} else {
+			for (; i<n; i++)
+				out[i]= std::max(a[i],b[i]);
+		}
+	}
+
+  public:
+
+	VHGWColumnFilter(const cv::Mat& src, cv::Mat& dst, bool isErosion, int length, int anchor, int stripWidth)
+		: src(src), dst(dst), isErosion(isErosion), length(length), anchor(anchor),
+		  rowBytes(src.cols*src.channels()), stripWidth(stripWidth),
+		  border(src.cols*src.channels(), isErosion ? 255 : 0) {
+
+		nStrips= (rowBytes+stripWidth-1)/stripWidth;
+	}
+
+	int getNumberOfStrips() const {
+
+		return nStrips;
+	}
+
+	void operator()(const cv::Range& range) const {
+
+		// suffix min of the current block (length rows)
+		// followed by the prefix min of the next block (1 row)
+		std::vector<uchar> buffer((length+1)*stripWidth);
+		uchar* prefix= &buffer[length*stripWidth];
+
+		for (int task=range.start; task<range.end; task++) {
+
+			int i0= (task/nStrips)*length;                  // first output row of the block
+			int nOut= std::min(length, src.rows-i0);        // output rows in the block
+			int x0= (task%nStrips)*stripWidth;              // first byte of the strip
+			int n= std::min(stripWidth, rowBytes-x0);       // bytes in the strip
+
+			// suffix[t] = min(P[i0+t], ..., P[i0+length-1])
+			uchar* suffix= &buffer[(length-1)*stripWidth];
+			std::copy(paddedRow(i0+length-1)+x0, paddedRow(i0+length-1)+x0+n, suffix);
+			for (int t=length-2; t>=0; t--, suffix-=stripWidth)
+				combine(paddedRow(i0+t)+x0, suffix, suffix-stripWidth, n);
+
+			// the first output is the whole block
+			std::copy(&buffer[0], &buffer[0]+n, dst.ptr<uchar>(i0)+x0);
+
+			// output[i0+t] = min(suffix[t], P[i0+length], ..., P[i0+length+t-1])
+			for (int t=1; t<nOut; t++) {
+
+				const uchar* entering= paddedRow(i0+length+t-1)+x0;
+				if (t==1)
+					std::copy(entering, entering+n, prefix);
+				else
+					combine(entering, prefix, prefix, n);
+
+				combine(&buffer[t*stripWidth], prefix, dst.ptr<uchar>(i0+t)+x0, n);
+			}
+		}
+	}
+};
+
+// Gray-level morphology with rectangular structuring elements
+// of any size at a constant cost per pixel.
+// The rectangle is separated into a vertical and a horizontal pass;
+// the horizontal pass is a vertical pass on the transposed image.
+// Results are the same as cv::erode, cv::dilate and cv::morphologyEx
+// with a rectangle anchored at its center and default borders.
+class GrayMorphology {
+
+  private:
+
+	  cv::Size size;  // size of the structuring element
+
+	  // buffers reused between calls
+	  cv::Mat vertical, transposed, horizontal;
+
+	  // Min (or max) along the columns over length rows
+	  void filterColumns(const cv::Mat& src, cv::Mat& dst, bool isErosion, int length, int anchor) {
+
+		  dst.create(src.rows,src.cols,src.type());
+		  if (length==1) {
+
+			  src.copyTo(dst);
+			  return;
+		  }
+
+		  int rowBytes= src.cols*src.channels();
+		  int nBlocks= (src.rows+length-1)/length;
+
+		  // large kernels give few blocks,
+		  // so blocks are also split into strips of at least 64 bytes
+		  int nStrips= std::max(1, std::min((rowBytes+63)/64, (4*cv::getNumThreads()+nBlocks-1)/nBlocks));
+		  int stripWidth= ((rowBytes+nStrips-1)/nStrips + 15) & ~15;
+
+		  VHGWColumnFilter body(src,dst,isErosion,length,anchor,stripWidth);
+		  cv::parallel_for_(cv::Range(0,nBlocks*body.getNumberOfStrips()),body);
+	  }
+
+	  // Erosion or dilation with the rectangle
+	  void filter(const cv::Mat& src, cv::Mat& dst, bool isErosion, int iterations) {
+
+		  CV_Assert(src.depth()==CV_8U);
+
+		  if (iterations<1) {
+
+			  src.copyTo(dst);
+			  return;
+		  }
+
+		  // n iterations with a rectangle are one pass with a larger rectangle
+		  int width= size.width+(iterations-1)*(size.width-1);
+		  int height= size.height+(iterations-1)*(size.height-1);
+		  int ax= (size.width/2)*iterations;
+		  int ay= (size.height/2)*iterations;
+
+		  filterColumns(src,vertical,isErosion,height,ay);
+
+		  if (width==1) {
+
+			  vertical.copyTo(dst);
+			  return;
+		  }
+
+		  cv::transpose(vertical,transposed);
+		  filterColumns(transposed,horizontal,isErosion,width,ax);
+		  cv::transpose(horizontal,dst);
+	  }
+
+  public:
+
+	  GrayMorphology(cv::Size size=cv::Size(3,3)) : size(size) {}
+
+	  // Sets the size of the rectangular structuring element
+	  void setElement(cv::Size sz) {
+
+		  CV_Assert(sz.width>0 && sz.height>0);
+		  size= sz;
+	  }
+
+	  // Gets the size of the structuring element
+	  cv::Size getElement() const {
+
+		  return size;
+	  }
+
+	  void erode(const cv::Mat& src, cv::Mat& dst, int iterations=1) {
+
+		  filter(src,dst,true,iterations);
+	  }
+
+	  void dilate(const cv::Mat& src, cv::Mat& dst, int iterations=1) {
+
+		  filter(src,dst,false,iterations);
+	  }
+
+	  // Applies cv::MORPH_ERODE, DILATE, OPEN, CLOSE, GRADIENT, TOPHAT or BLACKHAT
+	  void morphologyEx(const cv::Mat& src, cv::Mat& dst, int op, int iterations=1) {
+
+		  cv::Mat first;
+
+		  switch (op) {
+
+			case cv::MORPH_ERODE:
+				erode(src,dst,iterations);
+				break;
+
+			case cv::MORPH_DILATE:
+				dilate(src,dst,iterations);
+				break;
+
+			case cv::MORPH_OPEN:
+				erode(src,first,iterations);
+				dilate(first,dst,iterations);
+				break;
+
+			case cv::MORPH_CLOSE:
+				dilate(src,first,iterations);
+				erode(first,dst,iterations);
+				break;
+
+			case cv::MORPH_GRADIENT:
+				erode(src,first,iterations);
+				dilate(src,dst,iterations);
+				cv::subtract(dst,first,dst);
+				break;
+
+			case cv::MORPH_TOPHAT:
+				erode(src,first,iterations);
+				dilate(first,first,iterations);
+				cv::subtract(src,first,dst);
+				break;
+
+			case cv::MORPH_BLACKHAT:
+				dilate(src,first,iterations);
+				erode(first,first,iterations);
+				cv::subtract(first,src,dst);
+				break;
+
+			default:
+				CV_Error(cv::Error::StsBadArg, "unsupported morphological operation");
+		  }
+	  }
+
+	  cv::Mat morphologyEx(const cv::Mat& image, int op, int iterations=1) {
+
+		  cv::Mat result;
+		  morphologyEx(image,result,op,iterations);
+
+		  return result;
+	  }
+};
+
+#endif
@@ -19,6 +19,10 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2\core.hpp>
 #include <opencv2\imgproc.hpp>
 #include <opencv2\highgui.hpp>
+#include <iostream>
+
+#include "grayMorphology.h"
+#include "morphologyChain.h"
 
 int main()
 {
@@ -115,6 +119,24 @@ int main()
 	cv::namedWindow("Opened|Closed Image");
 	cv::imshow("Opened|Closed Image",image);
 
+	// Time the open/close sequence with separate calls
+	image= cv::imread("binary.bmp");
+	int64 time= cv::getTickCount();
+	cv::morphologyEx(image,result,cv::MORPH_OPEN,element5);
+	cv::morphologyEx(result,result,cv::MORPH_CLOSE,element5);
+	time= cv::getTickCount()-time;
+	std::cout << "time (open then close)= " << time << std::endl;
+
+	// and streamed through a morphology chain
+	MorphologyChain chain;
+	chain.open(cv::Size(5,5)).close(cv::Size(5,5));
+	cv::Mat chained;
+	time= cv::getTickCount();
+	chain.apply(image,chained);
+	time= cv::getTickCount()-time;
+	std::cout << "time (chain)= " << time << std::endl;
+	std::cout << "max difference= " << cv::norm(result,chained,cv::NORM_INF) << std::endl;
+
 	// Read input image (gray-level)
 	image = cv::imread("boldt.jpg",0);
 	if (!image.data)
@@ -171,6 +193,26 @@ int main()
 	cv::namedWindow("7x7 Closed Image");
 	cv::imshow("7x7 Closed Image", 255 - result);
 
+	// Black top-hat with a large 51x51 structuring element
+	cv::Mat element51(51, 51, CV_8U, cv::Scalar(1));
+	time = cv::getTickCount();
+	cv::morphologyEx(image, result, cv::MORPH_BLACKHAT, element51);
+	time = cv::getTickCount() - time;
+	std::cout << "time (cv::morphologyEx 51x51)= " << time << std::endl;
+
+	// same operation at a cost independent of the element size
+	GrayMorphology morpho(cv::Size(51, 51));
+	cv::Mat fastResult;
+	time = cv::getTickCount();
+	morpho.morphologyEx(image, fastResult, cv::MORPH_BLACKHAT);
+	time = cv::getTickCount() - time;
+	std::cout << "time (van Herk/Gil-Werman 51x51)= " << time << std::endl;
+	std::cout << "differences= " << cv::countNonZero(result != fastResult) << std::endl;
+
+	// Display the top-hat image
+	cv::namedWindow("51x51 Black Top-hat Image");
+	cv::imshow("51x51 Black Top-hat Image", 255 - fastResult);
+
 	cv::waitKey();
 	return 0;
 }
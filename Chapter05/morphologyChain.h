@@ -0,0 +1,347 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 5 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined MORPHOCHAIN
+#define MORPHOCHAIN
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// One operation of a morphology chain
+struct MorphologyStep {
+
+	enum Operation { ERODE, DILATE, THRESHOLD };
+
+	Operation op;
+	cv::Size size;      // rectangle (ERODE and DILATE)
+	cv::Point anchor;   // anchor in the rectangle
+	double thresh;      // cv::threshold parameters (THRESHOLD)
+	double maxval;
+	int thresholdType;
+
+	// Gets the value that leaves the operation unchanged (outside pixels)
+	uchar neutral() const {
+
+		return op==ERODE ? 255 : 0;
+	}
+};
+
+// Runs a chain of operations on one vertical tile of the image.
+// Rows are streamed from one operation to the next, each operation
+// keeping only as many rows as its rectangle is high.
+// Each tile is extended on each side by the reach of the operations
+// that follow, so that its columns are exact.
+class MorphologyChainBody : public cv::ParallelLoopBody {
+
+	// Buffers of one operation for the current tile
+	struct Stage {
+
+		int inBegin, inEnd;        // columns of the input row
+		int begin, end;            // columns of the output row
+		std::vector<uchar> input;  // current input row
+		std::vector<uchar> rows;   // last size.height horizontally filtered rows
+		int emitted;               // number of output rows produced
+	};
+
+	const cv::Mat& src;
+	cv::Mat& dst;
+	const std::vector<MorphologyStep>& steps;
+	int tileWidth;
+
+	// out[i] = min(a[i],b[i]) for erosion, max(a[i],b[i]) for dilation
+	static void combine(const uchar* a, const uchar* b, uchar* out, int n, bool isErosion) {
+
+		int i=0;
+#if CV_SIMD128
+		if (isErosion) {
+			for (; i<=n-16; i+=16)
+				cv::v_store(out+i, cv::v_min(cv::v_load(a+i),cv::v_load(b+i)));
+		} else {
+			for (; i<=n-16; i+=16)
+				cv::v_store(out+i, cv::v_max(cv::v_load(a+i),cv::v_load(b+i)));
+		}
+#endif
+		if (isErosion) {
+			for (; i<n; i++)
+				out[i]= std::min(a[i],b[i]);
+		} else {
+			for (; i<n; i++)
+				out[i]= std::max(a[i],b[i]);
+		}
+	}
+
+	// Destination of output row o of operation k
+	uchar* target(std::vector<Stage>& stages, int k, int o) const {
+
+		if (k+1 < static_cast<int>(stages.size()))
+			return &stages[k+1].input[0];
+
+		return dst.ptr<uchar>(o)+stages[k].begin*dst.channels();
+	}
+
+	// Combines the buffered rows into output row number emitted
+	void emit(std::vector<Stage>& stages, int k) const {
+
+		const MorphologyStep& step= steps[k];
+		Stage& stage= stages[k];
+		int n= (stage.end-stage.begin)*src.channels();
+		int o= stage.emitted++;
+
+		// rows outside the image are neutral, so they are skipped
+		int first= std::max(0, o-step.anchor.y);
+		int last= std::min(src.rows-1, o-step.anchor.y+step.size.height-1);
+
+		uchar* output= target(stages,k,o);
+		const uchar* row= &stage.rows[(first%step.size.height)*n];
+		std::copy(row, row+n, output);
+		for (int j=first+1; j<=last; j++)
+			combine(&stage.rows[(j%step.size.height)*n], output, output, n, step.op==MorphologyStep::ERODE);
+
+		if (k+1 < static_cast<int>(stages.size()))
+			receive(stages,k+1,o);
+	}
+
+	// Processes input row r of operation k (in stages[k].input)
+	void receive(std::vector<Stage>& stages, int k, int r) const {
+
+		const MorphologyStep& step= steps[k];
+		Stage& stage= stages[k];
+		int cn= src.channels();
+		uchar* input= &stage.input[0];
+
+		if (step.op==MorphologyStep::THRESHOLD) {
+
+			int n= stage.end-stage.begin;
+			cv::Mat in(1,n,src.type(),input);
+			cv::Mat out(1,n,src.type(),target(stages,k,r));
+			cv::threshold(in,out,step.thresh,step.maxval,step.thresholdType);
+
+			stage.emitted= r+1;
+			if (k+1 < static_cast<int>(stages.size()))
+				receive(stages,k+1,r);
+			return;
+		}
+
+		// columns outside the image are neutral
+		uchar neutral= step.neutral();
+		if (stage.inBegin<0)
+			std::fill(input, input+(std::min(0,stage.inEnd)-stage.inBegin)*cn, neutral);
+		if (stage.inEnd>src.cols)
+			std::fill(input+(std::max(src.cols,stage.inBegin)-stage.inBegin)*cn,
+			          input+(stage.inEnd-stage.inBegin)*cn, neutral);
+
+		// horizontal min (or max) over size.width pixels
+		int n= (stage.end-stage.begin)*cn;
+		uchar* filtered= &stage.rows[(r%step.size.height)*n];
+		std::copy(input, input+n, filtered);
+		for (int d=1; d<step.size.width; d++)
+			combine(input+d*cn, filtered, filtered, n, step.op==MorphologyStep::ERODE);
+
+		// output rows whose last input row has been received
+		while (stage.emitted < src.rows &&
+			   stage.emitted-step.anchor.y+step.size.height-1 <= r)
+			emit(stages,k);
+	}
+
+  public:
+
+	MorphologyChainBody(const cv::Mat& src, cv::Mat& dst, const std::vector<MorphologyStep>& steps, int tileWidth)
+		: src(src), dst(dst), steps(steps), tileWidth(tileWidth) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nSteps= static_cast<int>(steps.size());
+		int cn= src.channels();
+		std::vector<Stage> stages(nSteps);
+
+		for (int tile=range.start; tile<range.end; tile++) {
+
+			// columns needed by each operation, from the last one backwards
+			int begin= tile*tileWidth;
+			int end= std::min(begin+tileWidth, src.cols);
+			for (int k=nSteps-1; k>=0; k--) {
+
+				Stage& stage= stages[k];
+				stage.begin= begin;
+				stage.end= end;
+				if (steps[k].op!=MorphologyStep::THRESHOLD) {
+
+					begin-= steps[k].anchor.x;
+					end+= steps[k].size.width-1-steps[k].anchor.x;
+				}
+				stage.inBegin= begin;
+				stage.inEnd= end;
+
+				stage.input.resize((stage.inEnd-stage.inBegin)*cn);
+				if (steps[k].op!=MorphologyStep::THRESHOLD)
+					stage.rows.resize(steps[k].size.height*(stage.end-stage.begin)*cn);
+				stage.emitted= 0;
+			}
+
+			// stream the rows of the tile through the chain
+			int first= std::max(0,stages[0].inBegin);
+			int last= std::min(src.cols,stages[0].inEnd);
+			for (int j=0; j<src.rows; j++) {
+
+				const uchar* data= src.ptr<uchar>(j);
+				std::copy(data+first*cn, data+last*cn, &stages[0].input[(first-stages[0].inBegin)*cn]);
+				receive(stages,0,j);
+			}
+
+			// the last rows are completed with neutral rows
+			for (int k=0; k<nSteps; k++)
+				while (stages[k].emitted < src.rows)
+					emit(stages,k);
+		}
+	}
+};
+
+// Chain of morphological operations and thresholds on 8-bit images.
+// The image is processed in vertical tiles (in parallel), and the rows
+// of a tile are streamed through all the operations, so that
+// intermediate results are never stored as full images.
+// Results are the same as the corresponding sequence of
+// cv::erode, cv::dilate, cv::morphologyEx and cv::threshold calls
+// with rectangles anchored at their center and default borders.
+class MorphologyChain {
+
+  private:
+
+	  std::vector<MorphologyStep> steps;
+	  int tileWidth; // width of the vertical tiles, in pixels
+
+	  void addRect(MorphologyStep::Operation op, cv::Size size, int iterations) {
+
+		  CV_Assert(size.width>0 && size.height>0);
+		  if (iterations<1)
+			  return;
+
+		  // n iterations with a rectangle are one pass with a larger rectangle
+		  MorphologyStep step;
+		  step.op= op;
+		  step.size= cv::Size(size.width+(iterations-1)*(size.width-1),
+			                  size.height+(iterations-1)*(size.height-1));
+		  step.anchor= cv::Point((size.width/2)*iterations, (size.height/2)*iterations);
+		  step.thresh= step.maxval= 0.0;
+		  step.thresholdType= 0;
+		  steps.push_back(step);
+	  }
+
+  public:
+
+	  MorphologyChain() : tileWidth(128) {}
+
+	  // Removes all operations
+	  MorphologyChain& clear() {
+
+		  steps.clear();
+		  return *this;
+	  }
+
+	  MorphologyChain& erode(cv::Size size=cv::Size(3,3), int iterations=1) {
+
+		  addRect(MorphologyStep::ERODE,size,iterations);
+		  return *this;
+	  }
+
+	  MorphologyChain& dilate(cv::Size size=cv::Size(3,3), int iterations=1) {
+
+		  addRect(MorphologyStep::DILATE,size,iterations);
+		  return *this;
+	  }
+
+	  MorphologyChain& open(cv::Size size=cv::Size(3,3), int iterations=1) {
+
+		  erode(size,iterations);
+		  return dilate(size,iterations);
+	  }
+
+	  MorphologyChain& close(cv::Size size=cv::Size(3,3), int iterations=1) {
+
+		  dilate(size,iterations);
+		  return erode(size,iterations);
+	  }
+
+	  // Appends a cv::threshold with the given parameters
+	  // (a fixed threshold: rows are thresholded one at a time, so no Otsu or triangle)
+	  MorphologyChain& threshold(double thresh, double maxval, int type) {
+
+		  CV_Assert((type & (cv::THRESH_OTSU|cv::THRESH_TRIANGLE))==0);
+
+		  MorphologyStep step;
+		  step.op= MorphologyStep::THRESHOLD;
+		  step.size= cv::Size(1,1);
+		  step.anchor= cv::Point(0,0);
+		  step.thresh= thresh;
+		  step.maxval= maxval;
+		  step.thresholdType= type;
+		  steps.push_back(step);
+		  return *this;
+	  }
+
+	  // Gets the number of operations
+	  int size() const {
+
+		  return static_cast<int>(steps.size());
+	  }
+
+	  // Sets the width of the vertical tiles
+	  void setTileWidth(int width) {
+
+		  tileWidth= width<16 ? 16 : width;
+	  }
+
+	  // Gets the width of the vertical tiles
+	  int getTileWidth() const {
+
+		  return tileWidth;
+	  }
+
+	  // Applies the chain to an 8-bit image
+	  void apply(const cv::Mat& image, cv::Mat& result) const {
+
+		  CV_Assert(image.depth()==CV_8U);
+
+		  if (steps.empty()) {
+
+			  image.copyTo(result);
+			  return;
+		  }
+
+		  CV_Assert(image.data!=result.data); // cannot be done in-place
+		  result.create(image.rows,image.cols,image.type());
+
+		  int nTiles= (image.cols+tileWidth-1)/tileWidth;
+		  cv::parallel_for_(cv::Range(0,nTiles),
+			                MorphologyChainBody(image,result,steps,tileWidth));
+	  }
+
+	  cv::Mat apply(const cv::Mat& image) const {
+
+		  cv::Mat result;
+		  apply(image,result);
+
+		  return result;
+	  }
+};
+
+#endif
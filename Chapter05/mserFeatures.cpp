@@ -23,6 +23,9 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2/imgproc.hpp>
 #include <vector>
 
+#include "streamingMSER.h"
+#include "parallelMSER.h"
+
 int main()
 {
 	// Read input image
@@ -124,6 +127,58 @@ int main()
 	cv::namedWindow("MSER ellipses");
 	cv::imshow("MSER ellipses", image);
 
+	// Reload the input image
+	image = cv::imread("building.jpg", 0);
+	if (!image.data)
+		return 0;
+
+	// Time the detection of the point sets
+	int64 time = cv::getTickCount();
+	ptrMSER->detectRegions(image, points, rects);
+	time = cv::getTickCount() - time;
+	std::cout << "time (detectRegions)= " << time << std::endl;
+
+	// MSER statistics computed without point sets
+	StreamingMSER streamingMSER(5,     // delta value for local minima detection
+		                        200,   // min acceptable area
+		                        2000); // max acceptable area
+	MSERRegions regions;
+	time = cv::getTickCount();
+	streamingMSER.detect(image, regions);
+	time = cv::getTickCount() - time;
+	std::cout << "time (streaming MSER)= " << time << std::endl;
+	std::cout << regions.size() << " MSER statistics" << std::endl;
+
+	// Rectangular MSERs and ellipses from the region moments
+	for (int i = 0; i < static_cast<int>(regions.size()); i++) {
+
+		// ratio test
+		if (regions.getFillRatio(i) > 0.6)
+			cv::rectangle(image, regions.box[i], cv::Scalar(255), 2);
+		else
+			cv::ellipse(image, regions.getEllipse(i), cv::Scalar(255), 2);
+	}
+
+	// Display the image
+	cv::namedWindow("Streaming MSERs");
+	cv::imshow("Streaming MSERs", image);
+
+	// MSERs of the gray-level image and of the 3 color channels,
+	// on 256x256 tiles processed in parallel
+	cv::Mat color = cv::imread("building.jpg");
+	ParallelMSER parallelMSER(5, 200, 2000);
+	parallelMSER.setTiles(256, 64);
+	time = cv::getTickCount();
+	parallelMSER.detect(color, regions);
+	time = cv::getTickCount() - time;
+	std::cout << "time (parallel MSER, 4 channels)= " << time << std::endl;
+
+	int count[4] = { 0, 0, 0, 0 };
+	for (size_t i = 0; i < regions.size(); i++)
+		count[regions.channel[i]]++;
+	std::cout << count[0] << " gray, " << count[1] << " blue, "
+		      << count[2] << " green, " << count[3] << " red MSERs" << std::endl;
+
 	/*
 	// detection using mserFeatures class
 
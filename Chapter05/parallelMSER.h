@@ -0,0 +1,219 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 5 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined PMSER
+#define PMSER
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <vector>
+
+#include "streamingMSER.h"
+
+// Detects the MSERs of one (channel,tile) task after the other.
+// Task t is processed by worker t%nWorkers, with the detector of
+// this worker, so that each component-tree arena is used by one thread only.
+class ParallelMSERBody : public cv::ParallelLoopBody {
+
+	const std::vector<cv::Mat>& channels;
+	const std::vector<cv::Rect>& cores;  // tiles without their overlap
+	int overlap;
+	int nWorkers;
+	std::vector<StreamingMSER>& arenas;  // one detector per worker
+	std::vector<MSERRegions>& results;   // regions of each task
+
+	// Keeps the regions found in a tile that are complete
+	// and that belong to the tile core
+	void select(const MSERRegions& found, const cv::Rect& tile, const cv::Rect& core,
+		        const cv::Size& size, int channel, MSERRegions& regions) const {
+
+		for (size_t i=0; i<found.size(); i++) {
+
+			const cv::Rect& box= found.box[i];
+
+			// a region cut by a seam touches the side of the tile
+			if ((box.x==tile.x && tile.x>0) ||
+				(box.y==tile.y && tile.y>0) ||
+				(box.x+box.width==tile.x+tile.width && tile.x+tile.width<size.width) ||
+				(box.y+box.height==tile.y+tile.height && tile.y+tile.height<size.height))
+				continue;
+
+			// a region in the overlap is kept by the tile that owns its center
+			if (!core.contains(cv::Point(box.x+box.width/2, box.y+box.height/2)))
+				continue;
+
+			regions.push_back(found,i);
+			regions.channel.back()= static_cast<uchar>(channel);
+		}
+	}
+
+  public:
+
+	ParallelMSERBody(const std::vector<cv::Mat>& channels, const std::vector<cv::Rect>& cores, int overlap,
+		             int nWorkers, std::vector<StreamingMSER>& arenas, std::vector<MSERRegions>& results)
+		: channels(channels), cores(cores), overlap(overlap), nWorkers(nWorkers),
+		  arenas(arenas), results(results) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nTasks= static_cast<int>(results.size());
+		int nTiles= static_cast<int>(cores.size());
+		MSERRegions found;
+
+		for (int worker=range.start; worker<range.end; worker++) {
+
+			for (int task=worker; task<nTasks; task+=nWorkers) {
+
+				int channel= task/nTiles;
+				const cv::Mat& image= channels[channel];
+				const cv::Rect& core= cores[task%nTiles];
+
+				// the core with its overlap
+				cv::Rect tile(core.x-overlap, core.y-overlap, core.width+2*overlap, core.height+2*overlap);
+				tile&= cv::Rect(0,0,image.cols,image.rows);
+
+				arenas[worker].detect(image(tile),found);
+				found.translate(0,tile.tl());
+
+				results[task].clear();
+				if (nTiles==1)
+					select(found,tile,tile,image.size(),channel,results[task]);
+				else
+					select(found,tile,core,image.size(),channel,results[task]);
+			}
+		}
+	}
+};
+
+// MSER detection on several channels and on overlapping tiles
+// processed in parallel. Regions cut by a tile seam are rejected;
+// they are found complete in a neighbor tile as long as they are
+// smaller than the overlap, and a region found in several tiles is
+// only kept by the tile containing its center.
+// The detectors (and their component-tree buffers) are kept
+// from call to call, one per worker thread.
+class ParallelMSER {
+
+  private:
+
+	  int delta;
+	  int minArea;
+	  int maxArea;
+	  float maxVariation;
+	  int tileSize;   // side of the tile cores
+	  int overlap;    // pixels added on each side of a tile
+
+	  std::vector<StreamingMSER> arenas;
+	  std::vector<MSERRegions> results;
+	  std::vector<cv::Rect> cores;
+
+  public:
+
+	  // same defaults as cv::MSER
+	  ParallelMSER(int delta=5, int minArea=60, int maxArea=14400, float maxVariation=0.25f)
+		  : delta(delta), minArea(minArea), maxArea(maxArea), maxVariation(maxVariation),
+		    tileSize(512), overlap(64) {}
+
+	  void setDelta(int d) {
+
+		  delta= d;
+	  }
+
+	  void setAreaRange(int minA, int maxA) {
+
+		  minArea= minA;
+		  maxArea= maxA;
+	  }
+
+	  void setMaxVariation(float v) {
+
+		  maxVariation= v;
+	  }
+
+	  // Sets the tile size and the overlap between tiles.
+	  // Regions larger than the overlap may be missed at the seams.
+	  void setTiles(int size, int margin) {
+
+		  tileSize= size<16 ? 16 : size;
+		  overlap= margin<0 ? 0 : margin;
+	  }
+
+	  // Detects the dark and bright MSERs of each channel
+	  void detect(const std::vector<cv::Mat>& channels, MSERRegions& regions) {
+
+		  regions.clear();
+		  if (channels.empty())
+			  return;
+
+		  cv::Size size= channels[0].size();
+		  for (size_t c=0; c<channels.size(); c++)
+			  CV_Assert(channels[c].type()==CV_8UC1 && channels[c].size()==size);
+
+		  // tile cores
+		  cores.clear();
+		  for (int y=0; y<size.height; y+=tileSize)
+			  for (int x=0; x<size.width; x+=tileSize)
+				  cores.push_back(cv::Rect(x,y,tileSize,tileSize) & cv::Rect(0,0,size.width,size.height));
+
+		  // one detector per thread, kept between calls
+		  int nTasks= static_cast<int>(channels.size()*cores.size());
+		  int nWorkers= std::max(1,std::min(cv::getNumThreads(),nTasks));
+		  if (static_cast<int>(arenas.size())<nWorkers)
+			  arenas.resize(nWorkers);
+		  for (int w=0; w<nWorkers; w++) {
+
+			  arenas[w].setDelta(delta);
+			  arenas[w].setAreaRange(minArea,maxArea);
+			  arenas[w].setMaxVariation(maxVariation);
+		  }
+
+		  results.resize(nTasks);
+		  cv::parallel_for_(cv::Range(0,nWorkers),
+			                ParallelMSERBody(channels,cores,overlap,nWorkers,arenas,results),nWorkers);
+
+		  // concatenated in task order, so that the result
+		  // does not depend on the number of threads
+		  for (int t=0; t<nTasks; t++)
+			  for (size_t i=0; i<results[t].size(); i++)
+				  regions.push_back(results[t],i);
+	  }
+
+	  // Detects the MSERs of a gray-level image, or of the
+	  // gray-level version and of each channel of a color image
+	  void detect(const cv::Mat& image, MSERRegions& regions) {
+
+		  std::vector<cv::Mat> channels;
+		  if (image.channels()==3) {
+
+			  channels.resize(1);
+			  cv::cvtColor(image,channels[0],cv::COLOR_BGR2GRAY);
+			  std::vector<cv::Mat> colors;
+			  cv::split(image,colors);
+			  channels.insert(channels.end(),colors.begin(),colors.end());
+
+		  } else {
+
+			  channels.push_back(image);
+		  }
+
+		  detect(channels,regions);
+	  }
+};
+
+#endif
@@ -0,0 +1,495 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 5 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined PWATERSHS
+#define PWATERSHS
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Hierarchical queue of pixel offsets:
+// one FIFO per gray level, the lowest level is served first
+class HierarchicalQueue {
+
+	std::vector<std::vector<int> > queues;
+	std::vector<size_t> heads; // first unread element of each FIFO
+	int level;                 // lowest level that may be non-empty
+	size_t count;
+
+  public:
+
+	HierarchicalQueue() : queues(256), heads(256,0), level(256), count(0) {}
+
+	bool empty() const {
+
+		return count==0;
+	}
+
+	void push(int offset, int priority) {
+
+		queues[priority].push_back(offset);
+		if (priority<level)
+			level= priority;
+		count++;
+	}
+
+	// Removes the oldest offset of the lowest level
+	// and gets this level
+	int pop(int& priority) {
+
+		while (heads[level]==queues[level].size()) {
+
+			queues[level].clear();
+			heads[level]= 0;
+			level++;
+		}
+
+		count--;
+		priority= level;
+		return queues[level][heads[level]++];
+	}
+
+	void clear() {
+
+		for (int i=0; i<256; i++) {
+
+			queues[i].clear();
+			heads[i]= 0;
+		}
+		level= 256;
+		count= 0;
+	}
+};
+
+// Flooding of an 8-bit gradient image from labeled markers.
+// Labels (non-zero) are propagated to their 4-neighbors in order of
+// increasing gradient; a pixel is never flooded at a level lower than
+// the current one. The level at which each pixel is flooded is kept.
+// Only pixels inside the given region are visited.
+template <typename T>
+class WatershedFlooding {
+
+	cv::Mat& labels;
+	cv::Mat& levels;   // gradient, then flooding level of the labeled pixels
+	cv::Rect region;
+
+	// A labeled pixel borders the unknown if one of its neighbors is 0
+	bool isSeed(const T* label, int x, int y, int step) const {
+
+		return (x>region.x && label[-1]==0) ||
+			   (x<region.x+region.width-1 && label[1]==0) ||
+			   (y>region.y && label[-step]==0) ||
+			   (y<region.y+region.height-1 && label[step]==0);
+	}
+
+  public:
+
+	WatershedFlooding(cv::Mat& labels, cv::Mat& levels, const cv::Rect& region)
+		: labels(labels), levels(levels), region(region) {}
+
+	// Gets the offsets of the labeled pixels bordering unknown pixels
+	// in the rows [begin,end[ of the region, in raster order
+	void getSeeds(int begin, int end, std::vector<int>& seeds) const {
+
+		int step= labels.cols;
+		for (int j=begin; j<end; j++) {
+
+			const T* label= labels.ptr<T>(j);
+			for (int i=region.x; i<region.x+region.width; i++)
+				if (label[i]!=0 && isSeed(label+i,i,j,step))
+					seeds.push_back(j*step+i);
+		}
+	}
+
+	// Floods the region from the seeds, each one at its level
+	void flood(const std::vector<int>& seeds, HierarchicalQueue& queue) const {
+
+		uchar* level= levels.ptr<uchar>(0);
+		T* label= labels.ptr<T>(0);
+		int step= labels.cols;
+		int x0= region.x, x1= region.x+region.width-1;
+		int y0= region.y, y1= region.y+region.height-1;
+
+		queue.clear();
+		for (size_t i=0; i<seeds.size(); i++)
+			queue.push(seeds[i],level[seeds[i]]);
+
+		while (!queue.empty()) {
+
+			int current;
+			int p= queue.pop(current);
+			int x= p%step, y= p/step;
+			T l= label[p];
+
+			// label the unknown neighbors and queue them
+			// at their gradient value (or the current level if higher)
+			int neighbors[4];
+			int n= 0;
+			if (x>x0) neighbors[n++]= p-1;
+			if (x<x1) neighbors[n++]= p+1;
+			if (y>y0) neighbors[n++]= p-step;
+			if (y<y1) neighbors[n++]= p+step;
+
+			for (int k=0; k<n; k++) {
+
+				int q= neighbors[k];
+				if (label[q]==0) {
+
+					label[q]= l;
+					level[q]= std::max(level[q],static_cast<uchar>(current));
+					queue.push(q,level[q]);
+				}
+			}
+		}
+	}
+};
+
+// Floods each tile independently from its own markers.
+// A flooding coming from outside the tile cannot reach a pixel
+// before the lowest level over all paths from the tile seams;
+// pixels flooded at a strictly lower level are labeled as in a flooding
+// of the whole image, the others are reset to 0.
+template <typename T>
+class WatershedTileBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& gradient;
+	const cv::Mat& markers;
+	cv::Mat& labels;
+	cv::Mat& levels;
+	int tileSize;
+	int nTilesX;
+
+	// Resets the pixels that could be reached from outside the tile first
+	void resetUnsafe(const cv::Rect& region, HierarchicalQueue& queue, std::vector<short>& reach) const {
+
+		const uchar* grad= gradient.ptr<uchar>(0);
+		const T* marker= markers.ptr<T>(0);
+		T* label= labels.ptr<T>(0);
+		uchar* level= levels.ptr<uchar>(0);
+		int step= labels.cols;
+		int x0= region.x, x1= region.x+region.width-1;
+		int y0= region.y, y1= region.y+region.height-1;
+
+		// lowest level at which each pixel can be reached from the seams
+		// (256 if it cannot; markers are never reached)
+		reach.assign(region.area(),256);
+		queue.clear();
+
+		// entry points: the pixels along the sides that touch another tile
+		for (int j=y0; j<=y1; j++)
+			for (int i=x0; i<=x1; i++) {
+
+				bool seam= (j==y0 && y0>0) || (j==y1 && y1<labels.rows-1) ||
+					       (i==x0 && x0>0) || (i==x1 && x1<labels.cols-1);
+				int p= j*step+i;
+				if (seam && marker[p]==0) {
+
+					reach[(j-y0)*region.width+i-x0]= grad[p];
+					queue.push(p,grad[p]);
+				}
+
+				// only the first and last pixels of the inner rows
+				if (j>y0 && j<y1 && i==x0 && x1>x0)
+					i= x1-1;
+			}
+
+		while (!queue.empty()) {
+
+			int current;
+			int p= queue.pop(current);
+			int x= p%step, y= p/step;
+
+			int neighbors[4];
+			int n= 0;
+			if (x>x0) neighbors[n++]= p-1;
+			if (x<x1) neighbors[n++]= p+1;
+			if (y>y0) neighbors[n++]= p-step;
+			if (y<y1) neighbors[n++]= p+step;
+
+			for (int k=0; k<n; k++) {
+
+				int q= neighbors[k];
+				short& r= reach[(q/step-y0)*region.width+q%step-x0];
+				if (r==256 && marker[q]==0) {
+
+					r= std::max<short>(grad[q],current);
+					queue.push(q,r);
+				}
+			}
+		}
+
+		// flooded from inside at a strictly lower level, or reset
+		for (int j=y0; j<=y1; j++) {
+
+			const short* r= &reach[(j-y0)*region.width];
+			for (int i=x0; i<=x1; i++) {
+
+				int p= j*step+i;
+				if (marker[p]==0 && level[p]>=r[i-x0]) {
+
+					label[p]= 0;
+					level[p]= grad[p];
+				}
+			}
+		}
+	}
+
+  public:
+
+	WatershedTileBody(const cv::Mat& gradient, const cv::Mat& markers, cv::Mat& labels, cv::Mat& levels, int tileSize)
+		: gradient(gradient), markers(markers), labels(labels), levels(levels), tileSize(tileSize) {
+
+		nTilesX= (labels.cols+tileSize-1)/tileSize;
+	}
+
+	void operator()(const cv::Range& range) const {
+
+		HierarchicalQueue queue;
+		std::vector<int> seeds;
+		std::vector<short> reach;
+
+		for (int tile=range.start; tile<range.end; tile++) {
+
+			cv::Rect region((tile%nTilesX)*tileSize, (tile/nTilesX)*tileSize, tileSize, tileSize);
+			region&= cv::Rect(0,0,labels.cols,labels.rows);
+
+			WatershedFlooding<T> flooding(labels,levels,region);
+			seeds.clear();
+			flooding.getSeeds(region.y,region.y+region.height,seeds);
+			flooding.flood(seeds,queue);
+
+			if (region.area() < labels.rows*labels.cols)
+				resetUnsafe(region,queue,reach);
+		}
+	}
+};
+
+// Collects the seeds of the final flooding, one band of rows per task
+template <typename T>
+class WatershedSeedBody : public cv::ParallelLoopBody {
+
+	const WatershedFlooding<T>& flooding;
+	int bandHeight;
+	int nl;
+	std::vector<std::vector<int> >& seeds; // seeds of each band
+
+  public:
+
+	WatershedSeedBody(const WatershedFlooding<T>& flooding, int bandHeight, int nl,
+		              std::vector<std::vector<int> >& seeds)
+		: flooding(flooding), bandHeight(bandHeight), nl(nl), seeds(seeds) {}
+
+	void operator()(const cv::Range& range) const {
+
+		for (int band=range.start; band<range.end; band++) {
+
+			seeds[band].clear();
+			flooding.getSeeds(band*bandHeight, std::min((band+1)*bandHeight,nl), seeds[band]);
+		}
+	}
+};
+
+// Marker-based watershed segmentation of large images.
+// The image is cut into square tiles flooded in parallel;
+// the pixels whose label could depend on another tile are then
+// flooded again in a single pass, together with the tiles that
+// contained no marker, so that the result is the one of a flooding
+// of the whole image and does not depend on the number of threads.
+// Flooding follows the gradient of the image with a hierarchical queue.
+// Labels keep the type of the marker image (8-bit, 16-bit or 32-bit),
+// so that 8-bit markers give an 8-bit segmentation.
+class ParallelWatershedSegmenter {
+
+  private:
+
+	  cv::Mat markers;   // initial markers (0 for unknown pixels)
+	  cv::Mat labels;    // segmentation (same type as the markers)
+	  cv::Mat gradient;  // 8-bit gradient of the last image
+	  cv::Mat levels;    // level at which each pixel was flooded
+	  int tileSize;      // side of the square tiles
+
+	  template <typename T>
+	  void flood() {
+
+		  int nTilesX= (labels.cols+tileSize-1)/tileSize;
+		  int nTilesY= (labels.rows+tileSize-1)/tileSize;
+
+		  // 1. independent flooding of each tile
+		  cv::parallel_for_(cv::Range(0,nTilesX*nTilesY),
+			                WatershedTileBody<T>(gradient,markers,labels,levels,tileSize));
+
+		  if (nTilesX*nTilesY==1)
+			  return;
+
+		  // 2. seeds of the final flooding, collected in parallel by bands
+		  // and concatenated in raster order
+		  WatershedFlooding<T> flooding(labels,levels,cv::Rect(0,0,labels.cols,labels.rows));
+		  std::vector<std::vector<int> > bandSeeds(nTilesY);
+		  cv::parallel_for_(cv::Range(0,nTilesY),
+			                WatershedSeedBody<T>(flooding,tileSize,labels.rows,bandSeeds));
+
+		  std::vector<int> seeds;
+		  for (int b=0; b<nTilesY; b++)
+			  seeds.insert(seeds.end(),bandSeeds[b].begin(),bandSeeds[b].end());
+
+		  // 3. flooding of the reset pixels, each seed at its own level
+		  HierarchicalQueue queue;
+		  flooding.flood(seeds,queue);
+	  }
+
+  public:
+
+	  ParallelWatershedSegmenter() : tileSize(1024) {}
+
+	  // Sets the side of the square tiles flooded in parallel
+	  void setTileSize(int size) {
+
+		  tileSize= size<16 ? 16 : size;
+	  }
+
+	  // Gets the side of the tiles
+	  int getTileSize() const {
+
+		  return tileSize;
+	  }
+
+	  // Sets the markers (CV_8U, CV_16U or CV_32S, 0 for unknown pixels)
+	  void setMarkers(const cv::Mat& markerImage) {
+
+		  CV_Assert(markerImage.type()==CV_8U || markerImage.type()==CV_16U || markerImage.type()==CV_32S);
+
+		  // no conversion, labels keep the marker type
+		  markers= markerImage.clone();
+	  }
+
+	  // Segments an 8-bit image; its gradient is the
+	  // 3x3 morphological gradient (maximum over the channels)
+	  cv::Mat process(const cv::Mat &image) {
+
+		  CV_Assert(image.depth()==CV_8U);
+
+		  cv::morphologyEx(image,gradient,cv::MORPH_GRADIENT,cv::Mat());
+		  if (gradient.channels()>1) {
+
+			  std::vector<cv::Mat> channels;
+			  cv::split(gradient,channels);
+			  gradient= channels[0];
+			  for (size_t c=1; c<channels.size(); c++)
+				  cv::max(gradient,channels[c],gradient);
+		  }
+
+		  return processGradient(gradient);
+	  }
+
+	  // Segments from an 8-bit gradient image
+	  cv::Mat processGradient(const cv::Mat &grad) {
+
+		  CV_Assert(grad.type()==CV_8U && grad.size()==markers.size());
+
+		  // offsets are computed over the whole image
+		  if (grad.isContinuous())
+			  gradient= grad;
+		  else
+			  gradient= grad.clone();
+		  gradient.copyTo(levels);
+		  markers.copyTo(labels);
+
+		  switch (labels.depth()) {
+
+			case CV_8U:
+				flood<uchar>();
+				break;
+
+			case CV_16U:
+				flood<ushort>();
+				break;
+
+			default:
+				flood<int>();
+		  }
+
+		  return labels;
+	  }
+
+	  // Gets the labels (same type as the markers)
+	  cv::Mat getLabels() const {
+
+		  return labels;
+	  }
+
+	  // Return result in the form of an image
+	  cv::Mat getSegmentation() const {
+
+		  if (labels.type()==CV_8U)
+			  return labels;
+
+		  cv::Mat tmp;
+		  // all segment with label higher than 255
+		  // will be assigned value 255
+		  labels.convertTo(tmp,CV_8U);
+
+		  return tmp;
+	  }
+
+	  // Return watershed in the form of an image:
+	  // 0 where the label changes to the right or below, 255 elsewhere
+	  cv::Mat getWatersheds() const {
+
+		  cv::Mat tmp(labels.size(),CV_8U);
+
+		  switch (labels.depth()) {
+
+			case CV_8U:
+				getWatersheds<uchar>(tmp);
+				break;
+
+			case CV_16U:
+				getWatersheds<ushort>(tmp);
+				break;
+
+			default:
+				getWatersheds<int>(tmp);
+		  }
+
+		  return tmp;
+	  }
+
+  private:
+
+	  template <typename T>
+	  void getWatersheds(cv::Mat& lines) const {
+
+		  int nl= labels.rows;
+		  int nc= labels.cols;
+
+		  for (int j=0; j<nl; j++) {
+
+			  const T* label= labels.ptr<T>(j);
+			  const T* below= labels.ptr<T>(j<nl-1 ? j+1 : j);
+			  uchar* output= lines.ptr<uchar>(j);
+
+			  for (int i=0; i<nc; i++)
+				  output[i]= (i<nc-1 && label[i]!=label[i+1]) || label[i]!=below[i] ? 0 : 255;
+		  }
+	  }
+};
+
+#endif
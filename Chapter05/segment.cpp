@@ -21,6 +21,9 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include "watershedSegmentation.h"
+#include "binaryMorphology.h"
+#include "morphologyChain.h"
+#include "parallelWatershed.h"
 
 
 int main()
@@ -59,6 +62,37 @@ int main()
 	cv::namedWindow("Background Image");
 	cv::imshow("Background Image",bg);
 
+	// Same markers using bit-packed binary morphology
+	BinaryMorphology morpho(cv::MORPH_RECT,cv::Size(3,3));
+
+	int64 time= cv::getTickCount();
+	cv::erode(binary,fg,cv::Mat(),cv::Point(-1,-1),4);
+	time= cv::getTickCount()-time;
+	std::cout << "time (erode)= " << time << std::endl;
+
+	time= cv::getTickCount();
+	PackedMask packed, packedResult;
+	packed.pack(binary);
+	morpho.erode(packed,packedResult,4);
+	cv::Mat fgPacked;
+	packedResult.unpack(fgPacked);
+	time= cv::getTickCount()-time;
+	std::cout << "time (packed erode)= " << time << std::endl;
+	std::cout << "foreground differences= " << cv::countNonZero(fg!=fgPacked) << std::endl;
+
+	cv::Mat bgPacked= morpho.morphologyEx(binary,cv::MORPH_DILATE,4);
+	cv::threshold(bgPacked,bgPacked,1,128,cv::THRESH_BINARY_INV);
+	std::cout << "background differences= " << cv::countNonZero(bg!=bgPacked) << std::endl;
+
+	// Background marker in a single streamed pass
+	MorphologyChain chain;
+	chain.dilate(cv::Size(3,3),4).threshold(1,128,cv::THRESH_BINARY_INV);
+	time= cv::getTickCount();
+	cv::Mat bgChained= chain.apply(binary);
+	time= cv::getTickCount()-time;
+	std::cout << "time (chained dilate and threshold)= " << time << std::endl;
+	std::cout << "background differences (chained)= " << cv::countNonZero(bg!=bgChained) << std::endl;
+
 	// Show markers image
 	cv::Mat markers(binary.size(),CV_8U,cv::Scalar(0));
 	markers= fg+bg;
@@ -70,7 +104,10 @@ int main()
 
 	// Set markers and process
 	segmenter.setMarkers(markers);
+	time= cv::getTickCount();
     segmenter.process(image);
+	time= cv::getTickCount()-time;
+	std::cout << "time (cv::watershed)= " << time << std::endl;
 
     // Display segmentation result
 	cv::namedWindow("Segmentation");
@@ -80,6 +117,22 @@ int main()
 	cv::namedWindow("Watersheds");
 	cv::imshow("Watersheds",segmenter.getWatersheds());
 
+	// Same markers with the tile-parallel watershed
+	// (8-bit markers give an 8-bit segmentation, no conversion needed)
+	ParallelWatershedSegmenter parallelSegmenter;
+	parallelSegmenter.setTileSize(128);
+	parallelSegmenter.setMarkers(markers);
+
+	time= cv::getTickCount();
+	parallelSegmenter.process(image);
+	time= cv::getTickCount()-time;
+	std::cout << "time (parallel watershed)= " << time << std::endl;
+
+	cv::namedWindow("Parallel Segmentation");
+	cv::imshow("Parallel Segmentation",parallelSegmenter.getSegmentation());
+	cv::namedWindow("Parallel Watersheds");
+	cv::imshow("Parallel Watersheds",parallelSegmenter.getWatersheds());
+
     // Open another image
 	image= cv::imread("tower.jpg");
 
@@ -0,0 +1,466 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 5 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined SMSER
+#define SMSER
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+// MSER regions stored as a struct of arrays,
+// entry i of every array describes region i
+struct MSERRegions {
+
+	std::vector<int> area;          // number of pixels
+	std::vector<cv::Rect> box;      // bounding box
+	std::vector<uchar> level;       // gray level at which the region is the most stable
+	std::vector<uchar> bright;      // 1 for bright regions, 0 for dark ones
+	std::vector<uchar> channel;     // channel in which the region was found
+	std::vector<float> variation;   // area variation over +/- delta levels
+	std::vector<double> m10, m01;   // sums of x and y
+	std::vector<double> m20, m11, m02; // sums of x*x, x*y and y*y
+
+	size_t size() const {
+
+		return area.size();
+	}
+
+	void clear() {
+
+		area.clear(); box.clear(); level.clear(); bright.clear(); channel.clear(); variation.clear();
+		m10.clear(); m01.clear(); m20.clear(); m11.clear(); m02.clear();
+	}
+
+	// Appends region i of another set
+	void push_back(const MSERRegions& other, size_t i) {
+
+		area.push_back(other.area[i]);
+		box.push_back(other.box[i]);
+		level.push_back(other.level[i]);
+		bright.push_back(other.bright[i]);
+		channel.push_back(other.channel[i]);
+		variation.push_back(other.variation[i]);
+		m10.push_back(other.m10[i]); m01.push_back(other.m01[i]);
+		m20.push_back(other.m20[i]); m11.push_back(other.m11[i]); m02.push_back(other.m02[i]);
+	}
+
+	// Moves the regions from first to the end by the given offset
+	void translate(size_t first, cv::Point offset) {
+
+		double ox= offset.x, oy= offset.y;
+		for (size_t i=first; i<area.size(); i++) {
+
+			box[i]+= offset;
+			m20[i]+= 2.0*ox*m10[i] + ox*ox*area[i];
+			m11[i]+= oy*m10[i] + ox*m01[i] + ox*oy*area[i];
+			m02[i]+= 2.0*oy*m01[i] + oy*oy*area[i];
+			m10[i]+= ox*area[i];
+			m01[i]+= oy*area[i];
+		}
+	}
+
+	// Fraction of the bounding box covered by the region
+	double getFillRatio(int i) const {
+
+		return static_cast<double>(area[i])/box[i].area();
+	}
+
+	// Center of mass of the region
+	cv::Point2d getCentroid(int i) const {
+
+		return cv::Point2d(m10[i]/area[i], m01[i]/area[i]);
+	}
+
+	// Ellipse with the same second order moments as the region
+	cv::RotatedRect getEllipse(int i) const {
+
+		cv::Point2d c= getCentroid(i);
+		double a= m20[i]/area[i] - c.x*c.x;
+		double b= m11[i]/area[i] - c.x*c.y;
+		double d= m02[i]/area[i] - c.y*c.y;
+
+		// eigenvalues of the covariance matrix
+		double root= std::sqrt((a-d)*(a-d) + 4.0*b*b);
+		double l1= std::max(0.0, (a+d+root)/2.0);
+		double l2= std::max(0.0, (a+d-root)/2.0);
+		double angle= 0.5*std::atan2(2.0*b, a-d)*180.0/CV_PI;
+
+		// a uniform ellipse of axis length L has a variance of L*L/16
+		return cv::RotatedRect(cv::Point2f(static_cast<float>(c.x),static_cast<float>(c.y)),
+			                   cv::Size2f(static_cast<float>(4.0*std::sqrt(l1)),
+			                              static_cast<float>(4.0*std::sqrt(l2))),
+			                   static_cast<float>(angle));
+	}
+};
+
+// Maximally stable extremal regions of a gray-level image.
+// The component tree is built with a union-find over the pixels
+// sorted by gray level; each component carries its area, moments and
+// bounding box, which are copied in the history of the tree when its
+// area is in the accepted range. No pixel list is ever stored.
+// Dark regions and bright regions (inverted image) are both detected.
+class StreamingMSER {
+
+  private:
+
+	  int delta;           // level difference used to measure stability
+	  int minArea;         // accepted region areas
+	  int maxArea;
+	  float maxVariation;  // maximal relative area variation
+
+	  // union-find over pixels: index of the parent pixel,
+	  // -(component+1) for a root or UNPROCESSED
+	  std::vector<int> parent;
+	  std::vector<int> order; // pixels sorted by level
+
+	  // live components (struct of arrays, slots are recycled)
+	  std::vector<int> cArea;
+	  std::vector<int> cXmin, cYmin, cXmax, cYmax;
+	  std::vector<long long> cM10, cM01, cM20, cM11, cM02;
+	  std::vector<int> cChildren; // history nodes waiting for their parent
+	  std::vector<int> cLastChild; // last of them, for appending
+	  std::vector<int> cLevel;    // last level at which a node was created
+	  std::vector<int> freeSlots;
+
+	  // history of the component tree (struct of arrays)
+	  std::vector<uchar> hLevel;
+	  std::vector<int> hArea;
+	  std::vector<int> hParent;
+	  std::vector<int> hChild;    // first child
+	  std::vector<int> hNext;     // next sibling
+	  std::vector<int> hStats;    // index in the captured statistics, -1 if none
+
+	  MSERRegions captured;       // statistics of the nodes of accepted area
+
+	  enum { UNPROCESSED= INT_MAX };
+
+	  int find(int p) {
+
+		  while (parent[p]>=0) {
+
+			  int q= parent[p];
+			  if (parent[q]>=0)
+				  parent[p]= parent[q]; // path halving
+			  p= q;
+		  }
+
+		  return p;
+	  }
+
+	  // Starts a component with the pixel (x,y)
+	  int newComponent(int p, int x, int y) {
+
+		  int c;
+		  if (freeSlots.empty()) {
+
+			  c= static_cast<int>(cArea.size());
+			  cArea.push_back(0);
+			  cXmin.push_back(0); cYmin.push_back(0); cXmax.push_back(0); cYmax.push_back(0);
+			  cM10.push_back(0); cM01.push_back(0); cM20.push_back(0); cM11.push_back(0); cM02.push_back(0);
+			  cChildren.push_back(-1);
+			  cLastChild.push_back(-1);
+			  cLevel.push_back(-1);
+
+		  } else {
+
+			  c= freeSlots.back();
+			  freeSlots.pop_back();
+		  }
+
+		  cArea[c]= 1;
+		  cXmin[c]= cXmax[c]= x;
+		  cYmin[c]= cYmax[c]= y;
+		  cM10[c]= x; cM01[c]= y;
+		  cM20[c]= static_cast<long long>(x)*x;
+		  cM11[c]= static_cast<long long>(x)*y;
+		  cM02[c]= static_cast<long long>(y)*y;
+		  cChildren[c]= -1;
+		  cLastChild[c]= -1;
+		  cLevel[c]= -1;
+		  parent[p]= -(c+1);
+
+		  return c;
+	  }
+
+	  // Merges two root pixels, the larger component survives
+	  int merge(int r1, int r2) {
+
+		  int c1= -parent[r1]-1, c2= -parent[r2]-1;
+		  if (cArea[c1] < cArea[c2]) {
+
+			  std::swap(r1,r2);
+			  std::swap(c1,c2);
+		  }
+
+		  cArea[c1]+= cArea[c2];
+		  cXmin[c1]= std::min(cXmin[c1],cXmin[c2]); cYmin[c1]= std::min(cYmin[c1],cYmin[c2]);
+		  cXmax[c1]= std::max(cXmax[c1],cXmax[c2]); cYmax[c1]= std::max(cYmax[c1],cYmax[c2]);
+		  cM10[c1]+= cM10[c2]; cM01[c1]+= cM01[c2];
+		  cM20[c1]+= cM20[c2]; cM11[c1]+= cM11[c2]; cM02[c1]+= cM02[c2];
+
+		  // the waiting nodes of both components become siblings
+		  if (cChildren[c1]<0) {
+
+			  cChildren[c1]= cChildren[c2];
+			  cLastChild[c1]= cLastChild[c2];
+
+		  } else if (cChildren[c2]>=0) {
+
+			  hNext[cLastChild[c1]]= cChildren[c2];
+			  cLastChild[c1]= cLastChild[c2];
+		  }
+
+		  parent[r2]= r1;
+		  freeSlots.push_back(c2);
+
+		  return r1;
+	  }
+
+	  // Adds the state of a component at the given level to the history
+	  void addNode(int c, int level) {
+
+		  int node= static_cast<int>(hLevel.size());
+		  hLevel.push_back(static_cast<uchar>(level));
+		  hArea.push_back(cArea[c]);
+		  hParent.push_back(-1);
+		  hChild.push_back(cChildren[c]);
+		  hNext.push_back(-1);
+
+		  for (int child= cChildren[c]; child>=0; child= hNext[child])
+			  hParent[child]= node;
+
+		  // statistics are only kept for the areas that can be accepted
+		  if (cArea[c]>=minArea && cArea[c]<=maxArea) {
+
+			  hStats.push_back(static_cast<int>(captured.size()));
+			  captured.area.push_back(cArea[c]);
+			  captured.box.push_back(cv::Rect(cXmin[c],cYmin[c],cXmax[c]-cXmin[c]+1,cYmax[c]-cYmin[c]+1));
+			  captured.m10.push_back(static_cast<double>(cM10[c]));
+			  captured.m01.push_back(static_cast<double>(cM01[c]));
+			  captured.m20.push_back(static_cast<double>(cM20[c]));
+			  captured.m11.push_back(static_cast<double>(cM11[c]));
+			  captured.m02.push_back(static_cast<double>(cM02[c]));
+
+		  } else {
+
+			  hStats.push_back(-1);
+		  }
+
+		  cChildren[c]= node;
+		  cLastChild[c]= node;
+		  cLevel[c]= level;
+	  }
+
+	  // Builds the component tree of the image (inverted if bright)
+	  void buildTree(const cv::Mat& image, bool bright) {
+
+		  int nl= image.rows;
+		  int nc= image.cols;
+
+		  // counting sort of the pixels by level
+		  int start[257]= { 0 };
+		  for (int j=0; j<nl; j++) {
+
+			  const uchar* data= image.ptr<uchar>(j);
+			  for (int i=0; i<nc; i++)
+				  start[(bright ? 255-data[i] : data[i])+1]++;
+		  }
+		  for (int v=0; v<256; v++)
+			  start[v+1]+= start[v];
+
+		  order.resize(nl*nc);
+		  int next[256];
+		  std::copy(start, start+256, next);
+		  for (int j=0; j<nl; j++) {
+
+			  const uchar* data= image.ptr<uchar>(j);
+			  for (int i=0; i<nc; i++)
+				  order[next[bright ? 255-data[i] : data[i]]++]= j*nc+i;
+		  }
+
+		  parent.assign(nl*nc,UNPROCESSED);
+		  cArea.clear(); cXmin.clear(); cYmin.clear(); cXmax.clear(); cYmax.clear();
+		  cM10.clear(); cM01.clear(); cM20.clear(); cM11.clear(); cM02.clear();
+		  cChildren.clear(); cLastChild.clear(); cLevel.clear(); freeSlots.clear();
+		  hLevel.clear(); hArea.clear(); hParent.clear(); hChild.clear(); hNext.clear(); hStats.clear();
+		  captured.clear();
+
+		  std::vector<int> touched;
+		  for (int v=0; v<256; v++) {
+
+			  // flood the pixels of this level
+			  touched.clear();
+			  for (int k=start[v]; k<start[v+1]; k++) {
+
+				  int p= order[k];
+				  int x= p%nc, y= p/nc;
+				  newComponent(p,x,y);
+
+				  int root= p;
+				  if (x>0 && parent[p-1]!=UNPROCESSED)     root= join(root,p-1);
+				  if (x<nc-1 && parent[p+1]!=UNPROCESSED)  root= join(root,p+1);
+				  if (y>0 && parent[p-nc]!=UNPROCESSED)    root= join(root,p-nc);
+				  if (y<nl-1 && parent[p+nc]!=UNPROCESSED) root= join(root,p+nc);
+
+				  touched.push_back(root);
+			  }
+
+			  // one history node per component that changed at this level
+			  for (size_t k=0; k<touched.size(); k++) {
+
+				  int r= touched[k];
+				  if (parent[r]<0 && cLevel[-parent[r]-1]!=v)
+					  addNode(-parent[r]-1,v);
+			  }
+		  }
+	  }
+
+	  int join(int root, int q) {
+
+		  int r= find(q);
+		  return r==root ? root : merge(root,r);
+	  }
+
+	  // Selects the stable nodes of the tree
+	  void select(bool bright, MSERRegions& regions) const {
+
+		  int nNodes= static_cast<int>(hLevel.size());
+
+		  // largest child of each node
+		  std::vector<int> largest(nNodes,-1);
+		  for (int n=0; n<nNodes; n++) {
+
+			  int p= hParent[n];
+			  if (p>=0 && (largest[p]<0 || hArea[n]>hArea[largest[p]]))
+				  largest[p]= n;
+		  }
+
+		  // a node is the same region from its level up to the level of its parent;
+		  // its variation is the lowest one over these levels of
+		  // (area at level+delta - area at level-delta) / area
+		  std::vector<float> variation(nNodes);
+		  std::vector<uchar> stableLevel(nNodes);
+		  std::vector<int> chain;
+		  for (int n=0; n<nNodes; n++) {
+
+			  int end= hParent[n]>=0 ? hLevel[hParent[n]] : 256;
+
+			  // descendants through the largest children, down to level-delta
+			  chain.clear();
+			  for (int d=n; d>=0; d=largest[d]) {
+
+				  chain.push_back(d);
+				  if (hLevel[d]<=hLevel[n]-delta)
+					  break;
+			  }
+
+			  int up= n;
+			  size_t down= chain.size()-1;
+			  variation[n]= FLT_MAX;
+			  for (int l=hLevel[n]; l<end; l++) {
+
+				  while (hParent[up]>=0 && hLevel[hParent[up]]<=l+delta)
+					  up= hParent[up];
+				  while (down>0 && hLevel[chain[down-1]]<=l-delta)
+					  down--;
+
+				  int areaBelow= hLevel[chain[down]]<=l-delta ? hArea[chain[down]] : 0;
+				  float v= static_cast<float>(hArea[up]-areaBelow)/hArea[n];
+				  if (v<variation[n]) {
+
+					  variation[n]= v;
+					  stableLevel[n]= static_cast<uchar>(l);
+				  }
+
+				  if (v==0.0f)
+					  break;
+			  }
+		  }
+
+		  // local minima of the variation
+		  for (int n=0; n<nNodes; n++) {
+
+			  int s= hStats[n];
+			  if (s<0 || variation[n]>maxVariation)
+				  continue;
+
+			  if (hParent[n]>=0 && variation[n]>variation[hParent[n]])
+				  continue;
+
+			  bool stable= true;
+			  for (int c= hChild[n]; c>=0 && stable; c= hNext[c])
+				  stable= variation[n]<=variation[c];
+			  if (!stable)
+				  continue;
+
+			  regions.area.push_back(captured.area[s]);
+			  regions.box.push_back(captured.box[s]);
+			  regions.level.push_back(static_cast<uchar>(bright ? 255-stableLevel[n] : stableLevel[n]));
+			  regions.bright.push_back(bright ? 1 : 0);
+			  regions.channel.push_back(0);
+			  regions.variation.push_back(variation[n]);
+			  regions.m10.push_back(captured.m10[s]);
+			  regions.m01.push_back(captured.m01[s]);
+			  regions.m20.push_back(captured.m20[s]);
+			  regions.m11.push_back(captured.m11[s]);
+			  regions.m02.push_back(captured.m02[s]);
+		  }
+	  }
+
+  public:
+
+	  // same defaults as cv::MSER
+	  StreamingMSER(int delta=5, int minArea=60, int maxArea=14400, float maxVariation=0.25f)
+		  : delta(delta), minArea(minArea), maxArea(maxArea), maxVariation(maxVariation) {}
+
+	  void setDelta(int d) {
+
+		  delta= d;
+	  }
+
+	  void setAreaRange(int minA, int maxA) {
+
+		  minArea= minA;
+		  maxArea= maxA;
+	  }
+
+	  void setMaxVariation(float v) {
+
+		  maxVariation= v;
+	  }
+
+	  // Detects the dark and bright MSERs of a gray-level image
+	  void detect(const cv::Mat& image, MSERRegions& regions) {
+
+		  CV_Assert(image.type()==CV_8UC1);
+		  regions.clear();
+
+		  buildTree(image,false);
+		  select(false,regions);
+
+		  buildTree(image,true);
+		  select(true,regions);
+	  }
+};
+
+#endif
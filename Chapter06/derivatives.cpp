@@ -22,6 +22,7 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 #include "laplacianZC.h"
+#include "scaleSpace.h"
 
 int main()
 {
@@ -170,6 +171,29 @@ int main()
 	cv::namedWindow("Zero-crossings");
 	cv::imshow("Zero-crossings",255-zeros);
 
+	// Zero-crossings computed in a single pass from the image
+	int64 start= cv::getTickCount();
+	flap= laplacian.computeLaplacian(image);
+	cv::Mat binary;
+	cv::threshold(flap,binary,0,255,cv::THRESH_BINARY);
+	binary.convertTo(binary,CV_8U);
+	cv::Mat dilated;
+	cv::dilate(binary,dilated,cv::Mat());
+	cv::Mat twoPasses= dilated-binary; // non-positive pixels next to a positive one
+	double multiPass= (cv::getTickCount()-start)/cv::getTickFrequency();
+
+	start= cv::getTickCount();
+	cv::Mat singlePass= laplacian.computeZeroCrossings(image);
+	double fused= (cv::getTickCount()-start)/cv::getTickFrequency();
+	std::cout << "Zero-crossings: Laplacian, threshold and dilation " << multiPass*1000. << "ms, single pass "
+		      << fused*1000. << "ms (" << cv::countNonZero(twoPasses!=singlePass) << " different pixels)" << std::endl;
+
+	// Only the strong zero-crossings
+	laplacian.setThreshold(5000.);
+	cv::namedWindow("Strong zero-crossings");
+	cv::imshow("Strong zero-crossings",255-laplacian.computeZeroCrossings(image));
+	laplacian.setThreshold(0.);
+
 	// Print window pixel values
 	std::cout << "Zero values:\n\n";
 	for (int i=0; i<dx; i++) {
@@ -230,6 +254,29 @@ int main()
 	cv::namedWindow("Zero-crossings of DoG");
 	cv::imshow("Zero-crossings of DoG",255-zeros);
 
+	// DoG scale space, built twice as for two frames:
+	// the levels are allocated only once
+	ScaleSpace scaleSpace;
+	std::vector<cv::KeyPoint> blobs;
+	for (int frame=0; frame<2; frame++) {
+
+		int64 start= cv::getTickCount();
+		scaleSpace.build(image);
+		scaleSpace.detectExtrema(blobs);
+		double duration= (cv::getTickCount()-start)/cv::getTickFrequency();
+		std::cout << "Scale space (" << scaleSpace.getNumberOfOctaves() << " octaves): " << duration*1000.
+			      << "ms, " << blobs.size() << " extrema" << std::endl;
+	}
+
+	// Display the extrema at their scale
+	cv::Mat blobImage;
+	cv::cvtColor(image,blobImage,cv::COLOR_GRAY2BGR);
+	for (size_t i=0; i<blobs.size(); i++)
+		cv::circle(blobImage,blobs[i].pt,cvRound(blobs[i].size),
+			       blobs[i].response>0 ? cv::Scalar(0,0,255) : cv::Scalar(255,0,0));
+	cv::namedWindow("DoG extrema");
+	cv::imshow("DoG extrema",blobImage);
+
     // Display the image with window
 	cv::rectangle(image,cv::Rect(cx,cy,dx,dy),cv::Scalar(255,255,255));
 	cv::namedWindow("Original Image with window");
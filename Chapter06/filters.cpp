@@ -21,6 +21,9 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
+#include "gaussianFilter.h"
+#include "medianFilter.h"
+
 int main()
 {
 	// Read input image
@@ -63,6 +66,37 @@ int main()
 	cv::namedWindow("Gaussian filtered Image (9x9)");
 	cv::imshow("Gaussian filtered Image (9x9)",result);
 
+	// Very wide Gaussian blurs (background estimation)
+	GaussianFilter gaussian;
+	cv::Mat wide;
+	for (double sigma= 10.0; sigma<=50.0; sigma+= 20.0) {
+
+		int64 start= cv::getTickCount();
+		cv::GaussianBlur(image,result,cv::Size(0,0),sigma);
+		double separable= (cv::getTickCount()-start)/cv::getTickFrequency();
+
+		gaussian.setSigma(sigma);
+		gaussian.setMethod(GaussianFilter::RECURSIVE);
+		start= cv::getTickCount();
+		gaussian.filter(image,wide);
+		double recursive= (cv::getTickCount()-start)/cv::getTickFrequency();
+		double recursiveError= cv::norm(result,wide,cv::NORM_INF);
+
+		gaussian.setMethod(GaussianFilter::BOX);
+		start= cv::getTickCount();
+		gaussian.filter(image,wide);
+		double box= (cv::getTickCount()-start)/cv::getTickFrequency();
+		double boxError= cv::norm(result,wide,cv::NORM_INF);
+
+		std::cout << "sigma= " << sigma << ": GaussianBlur " << separable*1000. << "ms, recursive "
+			      << recursive*1000. << "ms (max diff " << recursiveError << "), box "
+				  << box*1000. << "ms (max diff " << boxError << ")" << std::endl;
+	}
+
+	// Display the background
+	cv::namedWindow("Background (sigma=50)");
+	cv::imshow("Background (sigma=50)",wide);
+
 	// Get the gaussian kernel (1.5)
 	cv::Mat gauss= cv::getGaussianKernel(9,1.5,CV_32F);
 		  
@@ -147,6 +181,29 @@ int main()
 	cv::namedWindow("Median filtered Image");
 	cv::imshow("Median filtered Image",result);
 
+	// Large median filters with constant cost per pixel
+	MedianFilter median;
+	cv::Mat color= cv::imread("boldt.jpg");
+	cv::Mat medianResult;
+	for (int size= 15; size<=31; size+= 16) {
+
+		int64 start= cv::getTickCount();
+		cv::medianBlur(color,result,size);
+		double opencv= (cv::getTickCount()-start)/cv::getTickFrequency();
+
+		median.setSize(size);
+		start= cv::getTickCount();
+		median.filter(color,medianResult);
+		double histogram= (cv::getTickCount()-start)/cv::getTickFrequency();
+
+		std::cout << size << "x" << size << " median: medianBlur " << opencv*1000. << "ms, histograms "
+			      << histogram*1000. << "ms (max diff " << cv::norm(result,medianResult,cv::NORM_INF) << ")" << std::endl;
+	}
+
+	// Display the filtered image
+	cv::namedWindow("Median filtered Image (31x31)");
+	cv::imshow("Median filtered Image (31x31)",medianResult);
+
 	// Reduce by 4 the size of the image (the wrong way)
 	image= cv::imread("boldt.jpg",0);
 	cv::Mat reduced(image.rows / 4, image.cols / 4, CV_8U);
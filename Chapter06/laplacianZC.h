@@ -21,6 +21,129 @@
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Zero-crossings of chunks of rows in a single pass: a pixel is marked
+// if its Laplacian is not positive and one of its 8 neighbors is positive
+// (and larger by more than the threshold). Outside the image, the row or
+// column of the pixel itself is used, which never creates a crossing.
+// The Laplacian is either given, or computed chunk by chunk from the image
+// in a small buffer (the image rows around the chunk are used, so that
+// values are those of cv::Laplacian on the whole image).
+class ZeroCrossingBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& laplace;   // CV_32F Laplacian, or empty
+	const cv::Mat& image;     // image, if no Laplacian is given
+	cv::Mat& zeros;           // CV_8U result
+	int aperture;
+	float threshold;
+	int chunkHeight;
+
+	// Marks the crossings of one row
+	void mark(const float* above, const float* row, const float* below, uchar* out, int n) const {
+
+		// first column, then the columns whose neighbors are all inside
+		if (n>0)
+			out[0]= crossing(above,row,below,0,n);
+		int x= 1;
+#if CV_SIMD128
+		cv::v_float32x4 zero= cv::v_setzero_f32(), thr= cv::v_setall_f32(threshold);
+		cv::v_int32x4 mask255= cv::v_setall_s32(255);
+		for (; x<=n-17; x+=16) {
+
+			cv::v_int32x4 m[4];
+			for (int k=0; k<4; k++) {
+
+				int i= x+4*k;
+				cv::v_float32x4 v= cv::v_load(row+i);
+				const float* rows[3]= { above+i, row+i, below+i };
+				cv::v_float32x4 found= cv::v_reinterpret_as_f32(cv::v_setzero_s32());
+				for (int r=0; r<3; r++) {
+
+					for (int dx=-1; dx<=1; dx++) {
+
+						cv::v_float32x4 q= cv::v_load(rows[r]+dx);
+						found= found | ((q > zero) & ((q - v) > thr));
+					}
+				}
+				found= found & (v <= zero);
+				m[k]= cv::v_reinterpret_as_s32(found) & mask255;
+			}
+			cv::v_store(out+x, cv::v_pack_u(cv::v_pack(m[0],m[1]), cv::v_pack(m[2],m[3])));
+		}
+#endif
+		for (; x<n; x++)
+			out[x]= crossing(above,row,below,x,n);
+	}
+
+	// 255 if pixel x is a crossing
+	uchar crossing(const float* above, const float* row, const float* below, int x, int n) const {
+
+		float v= row[x];
+		if (v>0.0f)
+			return 0;
+
+		int left= std::max(x-1,0);
+		int right= std::min(x+1,n-1);
+		const float* rows[3]= { above, row, below };
+		for (int r=0; r<3; r++) {
+
+			for (int i=left; i<=right; i++) {
+
+				float q= rows[r][i];
+				if (q>0.0f && q-v>threshold)
+					return 255;
+			}
+		}
+
+		return 0;
+	}
+
+  public:
+
+	ZeroCrossingBody(const cv::Mat& laplace, const cv::Mat& image, cv::Mat& zeros,
+		             int aperture, float threshold, int chunkHeight)
+		: laplace(laplace), image(image), zeros(zeros), aperture(aperture),
+		  threshold(threshold), chunkHeight(chunkHeight) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nl= zeros.rows;
+		int n= zeros.cols;
+		cv::Mat buffer;
+
+		for (int chunk=range.start; chunk<range.end; chunk++) {
+
+			int first= chunk*chunkHeight;
+			int last= std::min(first+chunkHeight,nl);
+
+			// Laplacian of the chunk and of the rows just above and below
+			int top= std::max(first-1,0);
+			int bottom= std::min(last+1,nl);
+			cv::Mat lap;
+			if (laplace.empty()) {
+
+				cv::Laplacian(image.rowRange(top,bottom),buffer,CV_32F,aperture);
+				lap= buffer;
+
+			} else {
+
+				lap= laplace.rowRange(top,bottom);
+			}
+
+			for (int j=first; j<last; j++) {
+
+				const float* row= lap.ptr<float>(j-top);
+				const float* above= j>0 ? lap.ptr<float>(j-1-top) : row;
+				const float* below= j<nl-1 ? lap.ptr<float>(j+1-top) : row;
+				mark(above,row,below,zeros.ptr<uchar>(j),n);
+			}
+		}
+	}
+};
 
 class LaplacianZC {
 
@@ -31,9 +154,21 @@ class LaplacianZC {
 	  // Aperture size of the laplacian kernel
 	  int aperture;
 
+	  // Minimum Laplacian difference across a zero-crossing
+	  double threshold;
+
+	  // Marks the zero-crossings of a Laplacian, or of the Laplacian of an image
+	  void zeroCrossings(const cv::Mat& laplace, const cv::Mat& image, cv::Mat& zeros) const {
+
+		  const int chunkHeight= 32;
+		  int nChunks= (zeros.rows+chunkHeight-1)/chunkHeight;
+		  cv::parallel_for_(cv::Range(0,nChunks),
+			                ZeroCrossingBody(laplace,image,zeros,aperture,static_cast<float>(threshold),chunkHeight));
+	  }
+
   public:
 
-	  LaplacianZC() : aperture(3) {}
+	  LaplacianZC() : aperture(3), threshold(0.0) {}
 
 	  // Set the aperture size of the kernel
 	  void setAperture(int a) {
@@ -56,6 +191,19 @@ class LaplacianZC {
 		  return laplace;
 	  }
 
+	  // Set the minimum difference of Laplacian values across a zero-crossing
+	  // (0 keeps all zero-crossings)
+	  void setThreshold(double t) {
+
+		  threshold= t;
+	  }
+
+	  // Get the zero-crossing threshold
+	  double getThreshold() const {
+
+		  return threshold;
+	  }
+
 	  // Get the Laplacian result in 8-bit image 
 	  // zero corresponds to gray level 128
 	  // if no scale is provided, then the max value will be
@@ -78,25 +226,30 @@ class LaplacianZC {
 	  }
 
 	  // Get a binary image of the zero-crossings
-	  // laplacian image should be CV_32F
+	  // (non-positive pixels with a positive neighbor)
+	  // laplacian image should be single-channel
 	  cv::Mat getZeroCrossings(cv::Mat laplace) {
 
-		  // threshold at 0
-		  // negative values in black
-		  // positive values in white
-		  cv::Mat signImage;
-		  cv::threshold(laplace,signImage,0,255,cv::THRESH_BINARY);
+		  CV_Assert(laplace.channels()==1);
+		  if (laplace.depth()!=CV_32F)
+			  laplace.convertTo(laplace,CV_32F);
 
-		  // convert the +/- image into CV_8U
-		  cv::Mat binary;
-		  signImage.convertTo(binary,CV_8U);
+		  cv::Mat zeros(laplace.size(),CV_8U);
+		  zeroCrossings(laplace,cv::Mat(),zeros);
 
-		  // dilate the binary image of +/- regions
-		  cv::Mat dilated;
-		  cv::dilate(binary,dilated,cv::Mat());
-	
-		  // return the zero-crossing contours
-		  return dilated-binary;
+		  return zeros;
+	  }
+
+	  // Get a binary image of the zero-crossings of the Laplacian of an image,
+	  // without computing the full Laplacian image
+	  cv::Mat computeZeroCrossings(const cv::Mat& image) {
+
+		  CV_Assert(image.channels()==1);
+
+		  cv::Mat zeros(image.size(),CV_8U);
+		  zeroCrossings(cv::Mat(),image,zeros);
+
+		  return zeros;
 	  }
 };
 
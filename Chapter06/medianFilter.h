@@ -0,0 +1,229 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 6 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined MEDIANFILTER
+#define MEDIANFILTER
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Median filter of one band of rows (Perreault and Hebert).
+// Each column (and channel) has a histogram of the size pixels above and below
+// the current row, updated by one pixel in and one out when moving down.
+// The kernel histogram is the sum of size column histograms, updated by one
+// column in and one out when moving right. Histograms are in two levels:
+// 16 coarse bins, used to find the segment of the median, and 256 fine bins,
+// whose segments (16 bins) are brought up to date only when the median falls into them.
+class MedianBandBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& src;
+	cv::Mat& dst;
+	int radius;
+	int bandHeight;
+
+	// h[i] += a[i] - b[i] over 16 bins
+	static void update(ushort* h, const ushort* a, const ushort* b) {
+
+#if CV_SIMD128
+		cv::v_store(h, cv::v_load(h) + cv::v_load(a) - cv::v_load(b));
+		cv::v_store(h+8, cv::v_load(h+8) + cv::v_load(a+8) - cv::v_load(b+8));
+#else
+		for (int i=0; i<16; i++)
+			h[i]= static_cast<ushort>(h[i]+a[i]-b[i]);
+#endif
+	}
+
+	// h[i] += a[i] over 16 bins
+	static void add(ushort* h, const ushort* a) {
+
+#if CV_SIMD128
+		cv::v_store(h, cv::v_load(h) + cv::v_load(a));
+		cv::v_store(h+8, cv::v_load(h+8) + cv::v_load(a+8));
+#else
+		for (int i=0; i<16; i++)
+			h[i]= static_cast<ushort>(h[i]+a[i]);
+#endif
+	}
+
+  public:
+
+	MedianBandBody(const cv::Mat& src, cv::Mat& dst, int radius, int bandHeight)
+		: src(src), dst(dst), radius(radius), bandHeight(bandHeight) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nl= src.rows;
+		int nc= src.cols;
+		int cn= src.channels();
+		int r= radius;
+		int rank= (2*r+1)*(2*r+1)/2; // 0-based rank of the median
+
+		// column histograms, one per column and channel
+		std::vector<ushort> fine(nc*cn*256);
+		std::vector<ushort> coarse(nc*cn*16);
+		// kernel histogram and the column at which each fine segment is up to date
+		ushort kernelCoarse[16];
+		ushort kernelFine[256];
+		int updated[16];
+
+		for (int band=range.start; band<range.end; band++) {
+
+			int first= band*bandHeight;
+			int last= std::min(first+bandHeight,nl);
+
+			// column histograms of the first row, with replicated rows
+			std::fill(fine.begin(),fine.end(),0);
+			std::fill(coarse.begin(),coarse.end(),0);
+			for (int j=first-r; j<=first+r; j++) {
+
+				const uchar* data= src.ptr<uchar>(std::min(std::max(j,0),nl-1));
+				for (int i=0; i<nc*cn; i++) {
+
+					fine[i*256+data[i]]++;
+					coarse[i*16+(data[i]>>4)]++;
+				}
+			}
+
+			for (int y=first; y<last; y++) {
+
+				// move the column histograms down
+				if (y>first) {
+
+					const uchar* out= src.ptr<uchar>(std::max(y-r-1,0));
+					const uchar* in= src.ptr<uchar>(std::min(y+r,nl-1));
+					for (int i=0; i<nc*cn; i++) {
+
+						fine[i*256+out[i]]--;
+						coarse[i*16+(out[i]>>4)]--;
+						fine[i*256+in[i]]++;
+						coarse[i*16+(in[i]>>4)]++;
+					}
+				}
+
+				uchar* output= dst.ptr<uchar>(y);
+				for (int c=0; c<cn; c++) {
+
+					// coarse kernel histogram of the first pixel, with replicated columns
+					std::fill(kernelCoarse,kernelCoarse+16,0);
+					for (int x=-r; x<=r; x++)
+						add(kernelCoarse,&coarse[(std::min(std::max(x,0),nc-1)*cn+c)*16]);
+					std::fill(updated,updated+16,-2*r-2); // all segments out of date
+
+					for (int x=0; x<nc; x++) {
+
+						int in= std::min(x+r,nc-1)*cn+c;
+						int out= std::max(x-r-1,0)*cn+c;
+						if (x>0)
+							update(kernelCoarse,&coarse[in*16],&coarse[out*16]);
+
+						// segment of the median
+						int count= 0;
+						int b= 0;
+						while (count+kernelCoarse[b]<=rank)
+							count+= kernelCoarse[b++];
+
+						// bring this segment of the fine histogram up to date
+						ushort* segment= kernelFine+16*b;
+						if (x-updated[b] > 2*r) {
+
+							std::fill(segment,segment+16,0);
+							for (int k=x-r; k<=x+r; k++)
+								add(segment,&fine[(std::min(std::max(k,0),nc-1)*cn+c)*256+16*b]);
+
+						} else {
+
+							for (int k=updated[b]+1; k<=x; k++)
+								update(segment,&fine[(std::min(k+r,nc-1)*cn+c)*256+16*b],
+									           &fine[(std::max(k-r-1,0)*cn+c)*256+16*b]);
+						}
+						updated[b]= x;
+
+						// median within the segment
+						int v= 0;
+						while (count+segment[v]<=rank)
+							count+= segment[v++];
+
+						output[x*cn+c]= static_cast<uchar>(16*b+v);
+					}
+				}
+			}
+		}
+	}
+};
+
+// Median filter of 8-bit images whose cost per pixel does not depend
+// on the aperture size (Perreault and Hebert, 2007). Any odd size up to 255
+// and any number of channels; borders are replicated, as in cv::medianBlur,
+// so results are identical. The image is processed in parallel bands of rows.
+class MedianFilter {
+
+  private:
+
+	  int size;    // aperture (odd)
+
+  public:
+
+	  MedianFilter(int size=15) : size(size) {}
+
+	  void setSize(int s) {
+
+		  size= s;
+	  }
+
+	  int getSize() const {
+
+		  return size;
+	  }
+
+	  // Filters an 8-bit image
+	  void filter(const cv::Mat& image, cv::Mat& result) const {
+
+		  CV_Assert(image.depth()==CV_8U);
+		  CV_Assert(size%2==1 && size>0 && size<=255);
+
+		  cv::Mat src= image;
+		  if (image.data==result.data)
+			  src= image.clone(); // in-place
+
+		  result.create(src.size(),src.type());
+		  if (src.empty())
+			  return;
+
+		  // bands at least as high as the aperture, since each band
+		  // starts with the histograms of size rows
+		  int radius= size/2;
+		  int nBands= std::max(1,std::min(cv::getNumThreads()*2,src.rows/size));
+		  int bandHeight= (src.rows+nBands-1)/nBands;
+		  nBands= (src.rows+bandHeight-1)/bandHeight;
+
+		  cv::parallel_for_(cv::Range(0,nBands),MedianBandBody(src,result,radius,bandHeight));
+	  }
+
+	  cv::Mat filter(const cv::Mat& image) const {
+
+		  cv::Mat result;
+		  filter(image,result);
+
+		  return result;
+	  }
+};
+
+#endif
@@ -0,0 +1,329 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 6 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined SCALESPACE
+#define SCALESPACE
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Builds the Gaussian and DoG levels of a set of octaves.
+// Each octave starts from the image reduced by 2^octave (pixel averaging),
+// so that octaves do not depend on each other; its levels are then
+// obtained one from the other, each blur only adding the missing sigma.
+class ScaleSpaceBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& input;                            // CV_32F image
+	std::vector<std::vector<cv::Mat> >& gaussians;
+	std::vector<std::vector<cv::Mat> >& dogs;
+	const std::vector<double>& increments;           // sigma added by each level
+	double baseSigma;                                // sigma of the first level
+	double initialSigma;                             // blur assumed in the image
+
+  public:
+
+	ScaleSpaceBody(const cv::Mat& input, std::vector<std::vector<cv::Mat> >& gaussians,
+		           std::vector<std::vector<cv::Mat> >& dogs, const std::vector<double>& increments,
+		           double baseSigma, double initialSigma)
+		: input(input), gaussians(gaussians), dogs(dogs), increments(increments),
+		  baseSigma(baseSigma), initialSigma(initialSigma) {}
+
+	void operator()(const cv::Range& range) const {
+
+		for (int o=range.start; o<range.end; o++) {
+
+			std::vector<cv::Mat>& levels= gaussians[o];
+
+			// averaging blocks of 2^o pixels leaves a sigma of about
+			// initialSigma/2^o plus that of the box, (1-4^-o)/12 in variance
+			double blur= initialSigma;
+			cv::Mat source= input;
+			if (o>0) {
+
+				int f= 1<<o;
+				cv::Mat block= input(cv::Rect(0,0,levels[0].cols*f,levels[0].rows*f));
+				cv::resize(block,levels[0],levels[0].size(),0,0,cv::INTER_AREA);
+				source= levels[0];
+				double r= 1.0/(f*f);
+				blur= std::sqrt(initialSigma*initialSigma*r + (1.0-r)/12.0);
+			}
+
+			if (baseSigma>blur)
+				cv::GaussianBlur(source,levels[0],cv::Size(),std::sqrt(baseSigma*baseSigma-blur*blur));
+			else
+				source.copyTo(levels[0]);
+
+			for (size_t i=1; i<levels.size(); i++) {
+
+				cv::GaussianBlur(levels[i-1],levels[i],cv::Size(),increments[i]);
+				cv::subtract(levels[i],levels[i-1],dogs[o][i-1]);
+			}
+		}
+	}
+};
+
+// Finds the DoG extrema of one (octave,level) task after the other:
+// pixels larger (or smaller) than their 26 neighbors in space and scale,
+// above the contrast threshold and not on an edge (ratio of principal curvatures).
+class ScaleSpaceExtremaBody : public cv::ParallelLoopBody {
+
+	const std::vector<std::vector<cv::Mat> >& dogs;
+	int levels;                                    // levels searched per octave
+	float threshold;
+	float edgeRatio;
+	const std::vector<double>& sigmas;             // sigma of each Gaussian level
+	std::vector<std::vector<cv::KeyPoint> >& results;
+
+  public:
+
+	ScaleSpaceExtremaBody(const std::vector<std::vector<cv::Mat> >& dogs, int levels, float threshold,
+		                  float edgeRatio, const std::vector<double>& sigmas,
+		                  std::vector<std::vector<cv::KeyPoint> >& results)
+		: dogs(dogs), levels(levels), threshold(threshold), edgeRatio(edgeRatio),
+		  sigmas(sigmas), results(results) {}
+
+	void operator()(const cv::Range& range) const {
+
+		// trace^2/det of the Hessian is below (r+1)^2/r
+		float edge= (edgeRatio+1.0f)*(edgeRatio+1.0f)/edgeRatio;
+
+		for (int task=range.start; task<range.end; task++) {
+
+			int o= task/levels;
+			int l= task%levels+1;
+			const cv::Mat& prev= dogs[o][l-1];
+			const cv::Mat& curr= dogs[o][l];
+			const cv::Mat& next= dogs[o][l+1];
+			std::vector<cv::KeyPoint>& points= results[task];
+			points.clear();
+
+			float scale= static_cast<float>(1<<o);
+
+			for (int y=1; y<curr.rows-1; y++) {
+
+				// rows y-1, y and y+1 of the 3 levels
+				const float* rows[9];
+				for (int dy=-1; dy<=1; dy++) {
+
+					rows[dy+1]= prev.ptr<float>(y+dy);
+					rows[dy+4]= curr.ptr<float>(y+dy);
+					rows[dy+7]= next.ptr<float>(y+dy);
+				}
+				const float* c= rows[4];
+
+				for (int x=1; x<curr.cols-1; x++) {
+
+					float v= c[x];
+					if (std::abs(v)<=threshold)
+						continue;
+
+					// 26 neighbors, stops at the first one that is not exceeded
+					bool extremum= true;
+					for (int k=0; k<9 && extremum; k++) {
+
+						for (int dx=-1; dx<=1; dx++) {
+
+							if (k==4 && dx==0)
+								continue;
+							float q= rows[k][x+dx];
+							if (v>0 ? q>=v : q<=v) {
+
+								extremum= false;
+								break;
+							}
+						}
+					}
+					if (!extremum)
+						continue;
+
+					// edge response
+					const float* up= rows[3]+x;
+					const float* down= rows[5]+x;
+					float dxx= c[x+1]+c[x-1]-2.0f*v;
+					float dyy= up[0]+down[0]-2.0f*v;
+					float dxy= 0.25f*(down[1]-down[-1]-up[1]+up[-1]);
+					float trace= dxx+dyy;
+					float det= dxx*dyy-dxy*dxy;
+					if (det<=0.0f || trace*trace>=edge*det)
+						continue;
+
+					// center of the pixel block in the image, diameter of 2 sigmas
+					cv::KeyPoint point(cv::Point2f((x+0.5f)*scale-0.5f,(y+0.5f)*scale-0.5f),
+						               static_cast<float>(2.0*sigmas[l])*scale, -1.0f, v, o);
+					points.push_back(point);
+				}
+			}
+		}
+	}
+};
+
+// Difference-of-Gaussians scale space: octaves of Gaussian levels
+// (scalesPerOctave+3 per octave) and of their differences.
+// All levels are allocated once per image size and reused from frame to frame;
+// octaves are built in parallel, and extrema are searched across scales.
+class ScaleSpace {
+
+  private:
+
+	  int nOctaves;          // maximum number of octaves
+	  int scalesPerOctave;
+	  double sigma;          // sigma of the first level of each octave
+	  double initialSigma;   // blur assumed in the input image
+	  float threshold;       // minimum absolute DoG value of an extremum
+	  float edgeRatio;       // maximum ratio of principal curvatures
+
+	  cv::Mat input;                                    // CV_32F copy of the image
+	  std::vector<std::vector<cv::Mat> > gaussians;     // [octave][level]
+	  std::vector<std::vector<cv::Mat> > dogs;          // [octave][level]
+	  std::vector<double> increments;                   // sigma added by each level
+	  std::vector<double> sigmas;                       // sigma of each level, in octave pixels
+	  std::vector<std::vector<cv::KeyPoint> > results;  // extrema of each task
+
+	  // Allocates the levels (nothing is done if the size is unchanged)
+	  void allocate(const cv::Size& size) {
+
+		  // the smallest octave has at least 8 pixels
+		  int n= 1;
+		  while (n<nOctaves && std::min(size.width>>n,size.height>>n)>=8)
+			  n++;
+
+		  int nLevels= scalesPerOctave+3;
+		  gaussians.resize(n);
+		  dogs.resize(n);
+		  for (int o=0; o<n; o++) {
+
+			  cv::Size s(size.width>>o,size.height>>o);
+			  gaussians[o].resize(nLevels);
+			  dogs[o].resize(nLevels-1);
+			  for (int i=0; i<nLevels; i++)
+				  gaussians[o][i].create(s,CV_32F);
+			  for (int i=0; i<nLevels-1; i++)
+				  dogs[o][i].create(s,CV_32F);
+		  }
+
+		  // level i has sigma*2^(i/s), obtained from level i-1
+		  double k= std::pow(2.0,1.0/scalesPerOctave);
+		  sigmas.resize(nLevels);
+		  increments.resize(nLevels);
+		  sigmas[0]= sigma;
+		  increments[0]= 0.0;
+		  for (int i=1; i<nLevels; i++) {
+
+			  sigmas[i]= sigmas[i-1]*k;
+			  increments[i]= std::sqrt(sigmas[i]*sigmas[i]-sigmas[i-1]*sigmas[i-1]);
+		  }
+	  }
+
+  public:
+
+	  ScaleSpace(int nOctaves=5, int scalesPerOctave=3, double sigma=1.6)
+		  : nOctaves(nOctaves), scalesPerOctave(scalesPerOctave), sigma(sigma),
+		    initialSigma(0.5), threshold(2.0f), edgeRatio(10.0f) {}
+
+	  void setNumberOfOctaves(int n) {
+
+		  nOctaves= n<1 ? 1 : n;
+	  }
+
+	  void setScalesPerOctave(int s) {
+
+		  scalesPerOctave= s<1 ? 1 : s;
+	  }
+
+	  void setSigma(double s) {
+
+		  sigma= s;
+	  }
+
+	  // Blur already present in the image
+	  void setInitialSigma(double s) {
+
+		  initialSigma= s;
+	  }
+
+	  // Minimum absolute DoG value of an extremum (in gray levels)
+	  void setThreshold(float t) {
+
+		  threshold= t;
+	  }
+
+	  // Maximum ratio of the principal curvatures of an extremum
+	  void setEdgeRatio(float r) {
+
+		  edgeRatio= r;
+	  }
+
+	  // Builds the octaves of a gray-level image
+	  void build(const cv::Mat& image) {
+
+		  CV_Assert(image.channels()==1);
+		  CV_Assert(scalesPerOctave>0 && sigma>0.0);
+
+		  image.convertTo(input,CV_32F);
+		  allocate(image.size());
+
+		  cv::parallel_for_(cv::Range(0,getNumberOfOctaves()),
+			                ScaleSpaceBody(input,gaussians,dogs,increments,sigma,initialSigma));
+	  }
+
+	  // Number of octaves built
+	  int getNumberOfOctaves() const {
+
+		  return static_cast<int>(gaussians.size());
+	  }
+
+	  // Gaussian level i of an octave (0 to scalesPerOctave+2)
+	  const cv::Mat& getGaussian(int octave, int i) const {
+
+		  return gaussians[octave][i];
+	  }
+
+	  // DoG level i of an octave (0 to scalesPerOctave+1)
+	  const cv::Mat& getDoG(int octave, int i) const {
+
+		  return dogs[octave][i];
+	  }
+
+	  // Sigma of Gaussian level i of an octave, in image pixels
+	  double getSigma(int octave, int i) const {
+
+		  return sigmas[i]*(1<<octave);
+	  }
+
+	  // Finds the extrema of the DoG levels 1 to scalesPerOctave of each octave.
+	  // Keypoints are in image coordinates; their size is twice the sigma of the level,
+	  // their response the DoG value and their octave the octave index.
+	  void detectExtrema(std::vector<cv::KeyPoint>& keypoints) {
+
+		  keypoints.clear();
+		  int nTasks= getNumberOfOctaves()*scalesPerOctave;
+		  results.resize(nTasks);
+		  cv::parallel_for_(cv::Range(0,nTasks),
+			                ScaleSpaceExtremaBody(dogs,scalesPerOctave,threshold,edgeRatio,sigmas,results));
+
+		  // in task order, whatever the number of threads
+		  for (int t=0; t<nTasks; t++)
+			  keypoints.insert(keypoints.end(),results[t].begin(),results[t].end());
+	  }
+};
+
+#endif
@@ -0,0 +1,469 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 7 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined BLOBLABELER
+#define BLOBLABELER
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+// Blob descriptors stored as a struct of arrays,
+// entry i of every array describes blob i (label i+1)
+struct Blobs {
+
+	std::vector<int> area;          // number of pixels
+	std::vector<int> perimeter;     // number of pixels on the border of the blob
+	std::vector<cv::Rect> box;      // bounding box
+	std::vector<double> m10, m01;   // sums of x and y
+	std::vector<double> m20, m11, m02; // sums of x*x, x*y and y*y
+
+	size_t size() const {
+
+		return area.size();
+	}
+
+	void clear() {
+
+		area.clear(); perimeter.clear(); box.clear();
+		m10.clear(); m01.clear(); m20.clear(); m11.clear(); m02.clear();
+	}
+
+	// Center of mass of the blob
+	cv::Point2d getCentroid(int i) const {
+
+		return cv::Point2d(m10[i]/area[i], m01[i]/area[i]);
+	}
+};
+
+// Statistics of the provisional labels of one band (struct of arrays)
+struct BlobAccumulator {
+
+	std::vector<int> area, perimeter;
+	std::vector<int> xmin, ymin, xmax, ymax;
+	std::vector<long long> m10, m01, m20, m11, m02;
+
+	void clear() {
+
+		area.clear(); perimeter.clear();
+		xmin.clear(); ymin.clear(); xmax.clear(); ymax.clear();
+		m10.clear(); m01.clear(); m20.clear(); m11.clear(); m02.clear();
+	}
+
+	// Adds an empty entry
+	void add() {
+
+		area.push_back(0); perimeter.push_back(0);
+		xmin.push_back(INT_MAX); ymin.push_back(INT_MAX);
+		xmax.push_back(-1); ymax.push_back(-1);
+		m10.push_back(0); m01.push_back(0);
+		m20.push_back(0); m11.push_back(0); m02.push_back(0);
+	}
+
+	// Adds pixel (x,y) to entry i
+	void addPixel(int i, int x, int y, bool onBorder) {
+
+		area[i]++;
+		perimeter[i]+= onBorder;
+		xmin[i]= std::min(xmin[i],x); xmax[i]= std::max(xmax[i],x);
+		ymin[i]= std::min(ymin[i],y); ymax[i]= std::max(ymax[i],y);
+		m10[i]+= x; m01[i]+= y;
+		m20[i]+= static_cast<long long>(x)*x;
+		m11[i]+= static_cast<long long>(x)*y;
+		m02[i]+= static_cast<long long>(y)*y;
+	}
+
+	// Adds entry j of other to entry i
+	void merge(int i, const BlobAccumulator& other, int j) {
+
+		area[i]+= other.area[j];
+		perimeter[i]+= other.perimeter[j];
+		xmin[i]= std::min(xmin[i],other.xmin[j]); xmax[i]= std::max(xmax[i],other.xmax[j]);
+		ymin[i]= std::min(ymin[i],other.ymin[j]); ymax[i]= std::max(ymax[i],other.ymax[j]);
+		m10[i]+= other.m10[j]; m01[i]+= other.m01[j];
+		m20[i]+= other.m20[j]; m11[i]+= other.m11[j]; m02[i]+= other.m02[j];
+	}
+};
+
+// Union-find over provisional labels, the smallest label is the root
+class LabelSets {
+
+	std::vector<int>& parent;
+
+  public:
+
+	LabelSets(std::vector<int>& parent) : parent(parent) {}
+
+	int find(int l) const {
+
+		while (parent[l]!=l) {
+
+			parent[l]= parent[parent[l]]; // path halving
+			l= parent[l];
+		}
+
+		return l;
+	}
+
+	int join(int l1, int l2) const {
+
+		l1= find(l1);
+		l2= find(l2);
+		if (l1<l2)
+			parent[l2]= l1;
+		else if (l2<l1)
+			parent[l1]= l2;
+
+		return std::min(l1,l2);
+	}
+};
+
+// Labels one band of rows by 2x2 blocks (8-connectivity).
+// The pixels of a block are always connected, so each block gets a single label,
+// and the statistics of its pixels are added to this label.
+// Labels of band b start at the index of its first block, so that
+// bands never share a label or a union-find entry.
+class BlobBandBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& binary;
+	std::vector<int>& blockLabels;            // label of each block (0 if empty)
+	std::vector<int>& parent;                 // union-find over labels
+	std::vector<BlobAccumulator>& bands;      // statistics of the labels of each band
+	std::vector<int>& firstLabels;            // first label of each band
+	int bandHeight;                           // in blocks
+
+  public:
+
+	BlobBandBody(const cv::Mat& binary, std::vector<int>& blockLabels, std::vector<int>& parent,
+		         std::vector<BlobAccumulator>& bands, std::vector<int>& firstLabels, int bandHeight)
+		: binary(binary), blockLabels(blockLabels), parent(parent), bands(bands),
+		  firstLabels(firstLabels), bandHeight(bandHeight) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nl= binary.rows;
+		int nc= binary.cols;
+		int bw= (nc+1)/2;                         // blocks per row
+		int bh= (nl+1)/2;
+		LabelSets sets(parent);
+
+		for (int band=range.start; band<range.end; band++) {
+
+			int first= band*bandHeight;
+			int last= std::min(first+bandHeight,bh);
+			BlobAccumulator& stats= bands[band];
+			stats.clear();
+			int base= first*bw+1;
+			firstLabels[band]= base;
+
+			for (int by=first; by<last; by++) {
+
+				int y= 2*by;
+				const uchar* r0= binary.ptr<uchar>(y);
+				const uchar* r1= y+1<nl ? binary.ptr<uchar>(y+1) : 0;
+				// row above the block, only inside the band
+				const uchar* up= by>first ? binary.ptr<uchar>(y-1) : 0;
+				// rows used for the perimeter
+				const uchar* above= y>0 ? binary.ptr<uchar>(y-1) : 0;
+				const uchar* below= y+2<nl ? binary.ptr<uchar>(y+2) : 0;
+				int* label= &blockLabels[by*bw];
+
+				for (int bx=0; bx<bw; bx++) {
+
+					int x= 2*bx;
+					bool right= x+1<nc;
+					bool a= r0[x]!=0;
+					bool b= right && r0[x+1]!=0;
+					bool c= r1 && r1[x]!=0;
+					bool d= r1 && right && r1[x+1]!=0;
+
+					if (!(a||b||c||d)) {
+
+						label[bx]= 0;
+						continue;
+					}
+
+					// connections with the blocks already labeled
+					int l= 0;
+					if (x>0 && (a||c) && (r0[x-1] || (r1 && r1[x-1])))
+						l= label[bx-1];
+					if (up) {
+
+						if ((a||b) && (up[x] || (right && up[x+1])))
+							l= l ? sets.join(l,label[bx-bw]) : label[bx-bw];
+						if (x>0 && a && up[x-1])
+							l= l ? sets.join(l,label[bx-bw-1]) : label[bx-bw-1];
+						if (x+2<nc && b && up[x+2])
+							l= l ? sets.join(l,label[bx-bw+1]) : label[bx-bw+1];
+					}
+
+					if (l==0) {
+
+						l= base+static_cast<int>(stats.area.size());
+						parent[l]= l;
+						stats.add();
+					}
+					label[bx]= l;
+
+					// statistics of the block pixels, added to its provisional label
+					int i= l-base;
+					const uchar* rows[4]= { above, r0, r1, below };
+					for (int k=0; k<2; k++) {
+
+						const uchar* row= rows[k+1];
+						if (!row)
+							continue;
+						int yy= y+k;
+						for (int xx=x; xx<x+2 && xx<nc; xx++) {
+
+							if (!row[xx])
+								continue;
+							bool border= xx==0 || xx==nc-1 || !row[xx-1] || !row[xx+1] ||
+								         !rows[k] || !rows[k][xx] || !rows[k+2] || !rows[k+2][xx];
+							stats.addPixel(i,xx,yy,border);
+						}
+					}
+				}
+			}
+		}
+	}
+};
+
+// Writes the final labels of one band of block rows
+class BlobLabelBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& binary;
+	const std::vector<int>& blockLabels;
+	const std::vector<int>& finalLabels;  // final label of each provisional label
+	cv::Mat& labels;
+
+  public:
+
+	BlobLabelBody(const cv::Mat& binary, const std::vector<int>& blockLabels,
+		          const std::vector<int>& finalLabels, cv::Mat& labels)
+		: binary(binary), blockLabels(blockLabels), finalLabels(finalLabels), labels(labels) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int bw= (binary.cols+1)/2;
+		for (int j=range.start; j<range.end; j++) {
+
+			const uchar* data= binary.ptr<uchar>(j);
+			const int* block= &blockLabels[(j/2)*bw];
+			int* output= labels.ptr<int>(j);
+
+			for (int i=0; i<binary.cols; i++)
+				output[i]= data[i] ? finalLabels[block[i/2]] : 0;
+		}
+	}
+};
+
+// Connected components (8-connectivity) of a binary image and their
+// statistics: area, bounding box, first and second order moments and
+// number of border pixels. The image is labeled by 2x2 blocks in
+// parallel bands; statistics are accumulated per provisional label
+// during the labeling and merged with the labels, so that the
+// pixels are read only once. The filters are applied before the
+// blobs (and the label image) are produced.
+class BlobLabeler {
+
+  private:
+
+	  int minArea, maxArea;            // accepted blob areas
+	  int minPerimeter, maxPerimeter;  // accepted number of border pixels
+	  int nBands;                      // number of bands (-1 for one per thread)
+
+	  // buffers reused from call to call
+	  std::vector<int> blockLabels;
+	  std::vector<int> parent;
+	  std::vector<int> finalLabels;
+	  std::vector<BlobAccumulator> bands;
+	  std::vector<int> firstLabels;
+
+	  // Band containing a provisional label
+	  int bandOf(int l, int band) const {
+
+		  while (l<firstLabels[band])
+			  band--;
+		  return band;
+	  }
+
+  public:
+
+	  BlobLabeler() : minArea(0), maxArea(INT_MAX), minPerimeter(0), maxPerimeter(INT_MAX), nBands(-1) {}
+
+	  // Keeps the blobs with an area in [minA,maxA]
+	  void setAreaRange(int minA, int maxA) {
+
+		  minArea= minA;
+		  maxArea= maxA;
+	  }
+
+	  // Keeps the blobs with a number of border pixels in [minP,maxP]
+	  void setPerimeterRange(int minP, int maxP) {
+
+		  minPerimeter= minP;
+		  maxPerimeter= maxP;
+	  }
+
+	  // Sets the number of bands processed in parallel (-1 for one per thread)
+	  void setNumberOfBands(int n) {
+
+		  nBands= n;
+	  }
+
+	  // Labels a binary image (non-zero pixels are foreground)
+	  // and gets the statistics of the accepted blobs.
+	  // Returns the number of accepted blobs.
+	  int process(const cv::Mat& binary, Blobs& blobs) {
+
+		  return labelBlobs(binary,blobs,0);
+	  }
+
+	  // Same, and gets the label image (CV_32S): 0 for the background
+	  // and the rejected blobs, i+1 for blob i
+	  int process(const cv::Mat& binary, Blobs& blobs, cv::Mat& labels) {
+
+		  return labelBlobs(binary,blobs,&labels);
+	  }
+
+  private:
+
+	  int labelBlobs(const cv::Mat& binary, Blobs& blobs, cv::Mat* labels) {
+
+		  CV_Assert(binary.type()==CV_8UC1);
+		  blobs.clear();
+
+		  int bw= (binary.cols+1)/2;
+		  int bh= (binary.rows+1)/2;
+		  if (bw==0 || bh==0)
+			  return 0;
+
+		  int n= nBands>0 ? nBands : cv::getNumThreads();
+		  n= std::max(1,std::min(n,bh));
+		  int bandHeight= (bh+n-1)/n;
+		  n= (bh+bandHeight-1)/bandHeight;
+
+		  blockLabels.resize(bw*bh);
+		  parent.resize(bw*bh+1);
+		  bands.resize(n);
+		  firstLabels.resize(n);
+
+		  // 1. labels and statistics of each band
+		  cv::parallel_for_(cv::Range(0,n),
+			                BlobBandBody(binary,blockLabels,parent,bands,firstLabels,bandHeight));
+
+		  // 2. connections across the bands
+		  LabelSets sets(parent);
+		  for (int band=1; band<n; band++) {
+
+			  int by= band*bandHeight;
+			  int y= 2*by;
+			  const uchar* r0= binary.ptr<uchar>(y);
+			  const uchar* up= binary.ptr<uchar>(y-1);
+			  const int* label= &blockLabels[by*bw];
+
+			  for (int bx=0; bx<bw; bx++) {
+
+				  if (!label[bx])
+					  continue;
+
+				  int x= 2*bx;
+				  bool right= x+1<binary.cols;
+				  bool a= r0[x]!=0;
+				  bool b= right && r0[x+1]!=0;
+
+				  if ((a||b) && (up[x] || (right && up[x+1])))
+					  sets.join(label[bx],label[bx-bw]);
+				  if (x>0 && a && up[x-1])
+					  sets.join(label[bx],label[bx-bw-1]);
+				  if (x+2<binary.cols && b && up[x+2])
+					  sets.join(label[bx],label[bx-bw+1]);
+			  }
+		  }
+
+		  // 3. statistics of each provisional label added to its root
+		  for (int band=0; band<n; band++) {
+
+			  int count= static_cast<int>(bands[band].area.size());
+			  for (int i=0; i<count; i++) {
+
+				  int l= firstLabels[band]+i;
+				  int root= sets.find(l);
+				  if (root!=l) {
+
+					  int rb= bandOf(root,band);
+					  bands[rb].merge(root-firstLabels[rb],bands[band],i);
+				  }
+			  }
+		  }
+
+		  // 4. filters, then final labels in order of the roots
+		  finalLabels.assign(bw*bh+1,0);
+		  for (int band=0; band<n; band++) {
+
+			  const BlobAccumulator& stats= bands[band];
+			  int count= static_cast<int>(stats.area.size());
+			  for (int i=0; i<count; i++) {
+
+				  int l= firstLabels[band]+i;
+				  if (parent[l]!=l)
+					  continue;
+
+				  if (stats.area[i]<minArea || stats.area[i]>maxArea ||
+					  stats.perimeter[i]<minPerimeter || stats.perimeter[i]>maxPerimeter)
+					  continue;
+
+				  blobs.area.push_back(stats.area[i]);
+				  blobs.perimeter.push_back(stats.perimeter[i]);
+				  blobs.box.push_back(cv::Rect(stats.xmin[i],stats.ymin[i],
+					                           stats.xmax[i]-stats.xmin[i]+1,stats.ymax[i]-stats.ymin[i]+1));
+				  blobs.m10.push_back(static_cast<double>(stats.m10[i]));
+				  blobs.m01.push_back(static_cast<double>(stats.m01[i]));
+				  blobs.m20.push_back(static_cast<double>(stats.m20[i]));
+				  blobs.m11.push_back(static_cast<double>(stats.m11[i]));
+				  blobs.m02.push_back(static_cast<double>(stats.m02[i]));
+				  finalLabels[l]= static_cast<int>(blobs.size());
+			  }
+		  }
+
+		  // 5. label image
+		  if (labels) {
+
+			  for (int band=0; band<n; band++) {
+
+				  int count= static_cast<int>(bands[band].area.size());
+				  for (int i=0; i<count; i++) {
+
+					  int l= firstLabels[band]+i;
+					  finalLabels[l]= finalLabels[sets.find(l)];
+				  }
+			  }
+
+			  labels->create(binary.size(),CV_32S);
+			  cv::parallel_for_(cv::Range(0,binary.rows),
+				                BlobLabelBody(binary,blockLabels,finalLabels,*labels));
+		  }
+
+		  return static_cast<int>(blobs.size());
+	  }
+};
+
+#endif
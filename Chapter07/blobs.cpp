@@ -23,6 +23,9 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
+#include "blobLabeler.h"
+#include "contourSet.h"
+
 int main()
 {
 	// Read input binary image
@@ -138,6 +141,86 @@ int main()
 	cv::namedWindow("Some Shape descriptors");
 	cv::imshow("Some Shape descriptors",result);
 
+	// Blob statistics computed while labeling the image
+	image= cv::imread("binaryGroup.bmp",0);
+	BlobLabeler labeler;
+	// same filter as for the contours, applied before the blobs are produced
+	// (the perimeter also counts the border of the holes)
+	labeler.setPerimeterRange(cmin,cmax);
+	Blobs blobs;
+	cv::Mat labels;
+
+	int64 start= cv::getTickCount();
+	labeler.process(image,blobs,labels);
+	double duration= (cv::getTickCount()-start)/cv::getTickFrequency();
+	std::cout << "Blobs: " << blobs.size() << " in " << duration*1000. << "ms" << std::endl;
+
+	// same statistics from the contours
+	cv::Mat copy= cv::imread("binaryGroup.bmp",0);
+	start= cv::getTickCount();
+	std::vector<std::vector<cv::Point> > blobContours;
+	cv::findContours(copy,blobContours,cv::RETR_EXTERNAL,cv::CHAIN_APPROX_NONE);
+	for (size_t i=0; i<blobContours.size(); i++) {
+
+		if (blobContours[i].size() < cmin || blobContours[i].size() > cmax)
+			continue;
+		cv::boundingRect(blobContours[i]);
+		cv::moments(blobContours[i]);
+	}
+	duration= (cv::getTickCount()-start)/cv::getTickFrequency();
+	std::cout << "Contours and moments: " << duration*1000. << "ms" << std::endl;
+
+	// draw the boxes and centroids of the blobs
+	cv::Mat blobImage(image.size(),CV_8U,cv::Scalar(255));
+	blobImage.setTo(cv::Scalar(128),labels>0);
+	for (size_t i=0; i<blobs.size(); i++) {
+
+		std::cout << "Blob " << i+1 << ": area= " << blobs.area[i]
+			      << " perimeter= " << blobs.perimeter[i] << std::endl;
+		cv::rectangle(blobImage,blobs.box[i],cv::Scalar(0),1);
+		cv::circle(blobImage,blobs.getCentroid(static_cast<int>(i)),2,cv::Scalar(0),2);
+	}
+
+	cv::namedWindow("Blobs");
+	cv::imshow("Blobs",blobImage);
+
+	// Contours stored in a single arena
+	image= cv::imread("binaryGroup.bmp",0);
+	ContourSet contourSet;
+
+	start= cv::getTickCount();
+	contourSet.find(image,cv::RETR_EXTERNAL);
+	contourSet.filter(cmin,cmax); // same filter as above
+	duration= (cv::getTickCount()-start)/cv::getTickFrequency();
+	std::cout << "Contour set: " << contourSet.size() << " contours in "
+		      << duration*1000. << "ms, " << contourSet.getBytes() << " bytes" << std::endl;
+
+	// the shape descriptors are computed on the arena
+	cv::Mat arenaResult(image.size(),CV_8U,cv::Scalar(255));
+	contourSet.draw(arenaResult,cv::Scalar(0),1);
+	for (int i=0; i<contourSet.size(); i++) {
+
+		cv::rectangle(arenaResult,contourSet.boundingRect(i),cv::Scalar(0),1);
+		contourSet.approxPolyDP(i,poly,5);
+		cv::polylines(arenaResult,poly,true,cv::Scalar(0),2);
+		cv::Moments m= contourSet.moments(i);
+		cv::circle(arenaResult,cv::Point(m.m10/m.m00,m.m01/m.m00),2,cv::Scalar(0),2);
+	}
+
+	// same contours as Freeman chains
+	contourSet.setChainCode(true);
+	contourSet.find(image,cv::RETR_EXTERNAL);
+	contourSet.filter(cmin,cmax);
+	std::cout << "Chain codes: " << contourSet.getBytes() << " bytes" << std::endl;
+	for (int i=0; i<contourSet.size(); i++) {
+
+		contourSet.convexHull(i,hull);
+		cv::polylines(arenaResult,hull,true,cv::Scalar(0),1);
+	}
+
+	cv::namedWindow("Contour set");
+	cv::imshow("Contour set",arenaResult);
+
 	// New call to findContours but with RETR_LIST flag
 	image= cv::imread("binaryGroup.bmp",0);
 
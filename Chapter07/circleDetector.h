@@ -0,0 +1,477 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 7 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined CIRCLEDETECTOR
+#define CIRCLEDETECTOR
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// A circle being detected, in the coordinates of the level it was found in
+struct CircleCandidate {
+
+	cv::Point2f center;
+	float radius;
+	int votes;        // center votes
+	float support;    // fraction of the circumference on edge pixels
+};
+
+// Votes every edge pixel for the centers lying along its gradient
+// direction (both ways) at distances minRadius to maxRadius.
+// Each worker votes for a band of rows in its own accumulator, which has
+// a 1-pixel border (for the local maxima).
+class CircleCenterBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& edges;
+	const cv::Mat& dx;        // CV_16S derivatives
+	const cv::Mat& dy;
+	int minRadius, maxRadius;
+	int nWorkers;
+	std::vector<std::vector<int> >& accumulators;
+
+  public:
+
+	CircleCenterBody(const cv::Mat& edges, const cv::Mat& dx, const cv::Mat& dy, int minRadius, int maxRadius,
+		             int nWorkers, std::vector<std::vector<int> >& accumulators)
+		: edges(edges), dx(dx), dy(dy), minRadius(minRadius), maxRadius(maxRadius),
+		  nWorkers(nWorkers), accumulators(accumulators) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nl= edges.rows;
+		int nc= edges.cols;
+		int stride= nc+2;
+
+		for (int w=range.start; w<range.end; w++) {
+
+			std::vector<int>& acc= accumulators[w];
+			acc.assign((nl+2)*stride,0);
+
+			for (int y=w*nl/nWorkers; y<(w+1)*nl/nWorkers; y++) {
+
+				const uchar* e= edges.ptr<uchar>(y);
+				const short* gx= dx.ptr<short>(y);
+				const short* gy= dy.ptr<short>(y);
+
+				for (int x=0; x<nc; x++) {
+
+					if (!e[x] || (gx[x]==0 && gy[x]==0))
+						continue;
+
+					float norm= 1.0f/std::sqrt(static_cast<float>(gx[x]*gx[x] + gy[x]*gy[x]));
+					float ux= gx[x]*norm;
+					float uy= gy[x]*norm;
+
+					for (int sign=-1; sign<=1; sign+=2) {
+
+						for (int r=minRadius; r<=maxRadius; r++) {
+
+							int cx= cvRound(x + sign*r*ux);
+							int cy= cvRound(y + sign*r*uy);
+							if (cx<0 || cy<0 || cx>=nc || cy>=nl)
+								break;
+							acc[(cy+1)*stride + cx+1]++;
+						}
+					}
+				}
+			}
+		}
+	}
+};
+
+// Sums the center accumulators of the workers over ranges of rows
+class CircleReduceBody : public cv::ParallelLoopBody {
+
+	const std::vector<std::vector<int> >& accumulators;
+	std::vector<int>& accumulator;
+	int stride;
+	int nWorkers;
+
+  public:
+
+	CircleReduceBody(const std::vector<std::vector<int> >& accumulators, std::vector<int>& accumulator,
+		             int stride, int nWorkers)
+		: accumulators(accumulators), accumulator(accumulator), stride(stride), nWorkers(nWorkers) {}
+
+	void operator()(const cv::Range& range) const {
+
+		for (int n=range.start; n<range.end; n++) {
+
+			int* out= &accumulator[n*stride];
+			std::copy(&accumulators[0][n*stride], &accumulators[0][n*stride]+stride, out);
+			for (int w=1; w<nWorkers; w++) {
+
+				const int* in= &accumulators[w][n*stride];
+				for (int i=0; i<stride; i++)
+					out[i]+= in[i];
+			}
+		}
+	}
+};
+
+// Estimates the radius of each candidate from the histogram of the distances
+// of the edge pixels around its center (1-pixel bins, smoothed over 3 bins).
+// The support is the fraction of the circumference covered by these edge pixels.
+class CircleRadiusBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& edges;
+	std::vector<CircleCandidate>& candidates;
+	int minRadius, maxRadius;
+
+  public:
+
+	CircleRadiusBody(const cv::Mat& edges, std::vector<CircleCandidate>& candidates, int minRadius, int maxRadius)
+		: edges(edges), candidates(candidates), minRadius(minRadius), maxRadius(maxRadius) {}
+
+	void operator()(const cv::Range& range) const {
+
+		std::vector<int> histogram(maxRadius+2);
+
+		for (int i=range.start; i<range.end; i++) {
+
+			CircleCandidate& c= candidates[i];
+			std::fill(histogram.begin(),histogram.end(),0);
+
+			cv::Rect box(cvFloor(c.center.x)-maxRadius-1, cvFloor(c.center.y)-maxRadius-1,
+				         2*maxRadius+3, 2*maxRadius+3);
+			box&= cv::Rect(0,0,edges.cols,edges.rows);
+			for (int y=box.y; y<box.y+box.height; y++) {
+
+				const uchar* e= edges.ptr<uchar>(y);
+				float ey= y-c.center.y;
+				for (int x=box.x; x<box.x+box.width; x++) {
+
+					if (!e[x])
+						continue;
+
+					float ex= x-c.center.x;
+					int bin= cvRound(std::sqrt(ex*ex + ey*ey));
+					if (bin>=minRadius-1 && bin<=maxRadius+1)
+						histogram[bin]++;
+				}
+			}
+
+			// best radius, refined by the mean of its 3 bins
+			int best= -1;
+			int bestCount= 0;
+			for (int r=std::max(minRadius,1); r<=maxRadius; r++) {
+
+				int count= histogram[r-1]+histogram[r]+histogram[r+1];
+				if (count>bestCount) {
+
+					best= r;
+					bestCount= count;
+				}
+			}
+
+			if (best<0) {
+
+				c.radius= 0.0f;
+				c.support= 0.0f;
+
+			} else {
+
+				c.radius= static_cast<float>(best) +
+					      static_cast<float>(histogram[best+1]-histogram[best-1])/bestCount;
+				c.support= static_cast<float>(bestCount/(2.0*CV_PI*c.radius));
+			}
+		}
+	}
+};
+
+// Refines each candidate at full resolution, inside a region around it:
+// edges, center votes restricted to radii close to the coarse one,
+// center taken near the coarse one, and radius histogram.
+class CircleRefineBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& image;
+	std::vector<CircleCandidate>& candidates;   // in full resolution coordinates
+	float margin;                               // uncertainty of the coarse estimates
+	double lowThreshold, highThreshold;
+
+  public:
+
+	CircleRefineBody(const cv::Mat& image, std::vector<CircleCandidate>& candidates, float margin,
+		             double lowThreshold, double highThreshold)
+		: image(image), candidates(candidates), margin(margin),
+		  lowThreshold(lowThreshold), highThreshold(highThreshold) {}
+
+	void operator()(const cv::Range& range) const {
+
+		cv::Mat edges, dx, dy;
+		std::vector<std::vector<int> > accumulator(1);
+
+		for (int i=range.start; i<range.end; i++) {
+
+			CircleCandidate& c= candidates[i];
+			int minRadius= std::max(1,cvFloor(c.radius-margin));
+			int maxRadius= cvCeil(c.radius+margin);
+
+			cv::Rect roi(cvFloor(c.center.x-maxRadius-margin)-1, cvFloor(c.center.y-maxRadius-margin)-1,
+				         cvCeil(2*(maxRadius+margin))+3, cvCeil(2*(maxRadius+margin))+3);
+			roi&= cv::Rect(0,0,image.cols,image.rows);
+			if (roi.width<3 || roi.height<3) {
+
+				c.support= 0.0f;
+				continue;
+			}
+
+			// the derivatives of a region use the pixels around it
+			cv::Canny(image(roi),edges,lowThreshold,highThreshold);
+			cv::Sobel(image(roi),dx,CV_16S,1,0);
+			cv::Sobel(image(roi),dy,CV_16S,0,1);
+
+			CircleCenterBody(edges,dx,dy,minRadius,maxRadius,1,accumulator)(cv::Range(0,1));
+
+			// the most voted center close to the coarse one
+			int stride= roi.width+2;
+			cv::Point2f local= c.center-cv::Point2f(static_cast<float>(roi.x),static_cast<float>(roi.y));
+			int best= -1;
+			for (int y=std::max(0,cvFloor(local.y-margin)); y<=std::min(roi.height-1,cvCeil(local.y+margin)); y++)
+				for (int x=std::max(0,cvFloor(local.x-margin)); x<=std::min(roi.width-1,cvCeil(local.x+margin)); x++)
+					if (best<0 || accumulator[0][(y+1)*stride+x+1]>accumulator[0][best])
+						best= (y+1)*stride+x+1;
+
+			// no vote near the coarse center: no centroid either
+			if (best<0 || accumulator[0][best]==0) {
+
+				c.support= 0.0f;
+				continue;
+			}
+
+			// sub-pixel center: centroid of the 3x3 votes around the peak
+			float sum= 0.0f, sx= 0.0f, sy= 0.0f;
+			for (int oy=-1; oy<=1; oy++) {
+
+				for (int ox=-1; ox<=1; ox++) {
+
+					float v= static_cast<float>(accumulator[0][best+oy*stride+ox]);
+					sum+= v;
+					sx+= v*ox;
+					sy+= v*oy;
+				}
+			}
+
+			std::vector<CircleCandidate> refined(1,c);
+			refined[0].center= cv::Point2f(best%stride-1+sx/sum,best/stride-1+sy/sum);
+			refined[0].votes= accumulator[0][best];
+			CircleRadiusBody(edges,refined,minRadius,maxRadius)(cv::Range(0,1));
+
+			c= refined[0];
+			c.center+= cv::Point2f(static_cast<float>(roi.x),static_cast<float>(roi.y));
+		}
+	}
+};
+
+// Circle detector working from coarse to fine: centers and radii are
+// found on a reduced level of a pyramid, where voting is cheap, then each
+// candidate is refined at full resolution inside its own region of interest.
+// Centers are voted along the gradient direction (as with cv::HOUGH_GRADIENT);
+// voting, radius estimation and refinement are done in parallel.
+class CircleDetector {
+
+  private:
+
+	  int minRadius, maxRadius;   // at full resolution
+	  double minDist;             // between centers
+	  double cannyThreshold;      // high Canny threshold (the low one is half)
+	  float minSupport;           // fraction of the circumference on edges
+	  int maxLevels;              // pyramid levels
+	  int minCoarseRadius;        // smallest radius at the coarse level
+
+	  std::vector<cv::Mat> pyramid;
+	  std::vector<std::vector<int> > accumulators;
+	  std::vector<int> accumulator;
+
+	  // time spent in each stage (ms)
+	  double pyramidTime, edgeTime, centerTime, radiusTime, refineTime;
+
+  public:
+
+	  CircleDetector(int minRadius=15, int maxRadius=50)
+		  : minRadius(minRadius), maxRadius(maxRadius), minDist(20.), cannyThreshold(200.),
+		    minSupport(0.3f), maxLevels(4), minCoarseRadius(4),
+		    pyramidTime(0.), edgeTime(0.), centerTime(0.), radiusTime(0.), refineTime(0.) {}
+
+	  void setRadiusRange(int minR, int maxR) {
+
+		  minRadius= minR;
+		  maxRadius= maxR;
+	  }
+
+	  void setMinDistance(double d) {
+
+		  minDist= d;
+	  }
+
+	  void setCannyThreshold(double t) {
+
+		  cannyThreshold= t;
+	  }
+
+	  // Minimum fraction of the circumference that must be on edge pixels
+	  void setMinSupport(float s) {
+
+		  minSupport= s;
+	  }
+
+	  // Maximum number of reductions; fewer are used so that the smallest
+	  // radius is at least minRadius pixels at the coarse level
+	  void setLevels(int levels, int minRadius=4) {
+
+		  maxLevels= std::max(levels,0);
+		  minCoarseRadius= std::max(minRadius,2);
+	  }
+
+	  // Detects the circles of a gray-level image; they are returned as
+	  // (x,y,radius), sorted by decreasing support
+	  void detect(const cv::Mat& image, std::vector<cv::Vec3f>& circles) {
+
+		  CV_Assert(image.type()==CV_8UC1);
+		  circles.clear();
+
+		  // levels of the pyramid
+		  int64 start= cv::getTickCount();
+		  int levels= 0;
+		  while (levels<maxLevels && (minRadius>>(levels+1))>=minCoarseRadius)
+			  levels++;
+		  pyramid.resize(levels+1);
+		  pyramid[0]= image;
+		  for (int l=1; l<=levels; l++)
+			  cv::pyrDown(pyramid[l-1],pyramid[l]);
+		  const cv::Mat& coarse= pyramid[levels];
+		  float scale= static_cast<float>(1<<levels);
+		  pyramidTime= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+
+		  // edges at the coarse level
+		  start= cv::getTickCount();
+		  cv::Mat edges, dx, dy;
+		  cv::Canny(coarse,edges,cannyThreshold/2,cannyThreshold);
+		  cv::Sobel(coarse,dx,CV_16S,1,0);
+		  cv::Sobel(coarse,dy,CV_16S,0,1);
+		  edgeTime= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+
+		  // center votes in parallel bands, then summed
+		  start= cv::getTickCount();
+		  int minR= std::max(1,cvFloor(minRadius/scale));
+		  int maxR= cvCeil(maxRadius/scale);
+		  int nWorkers= std::max(1,std::min(cv::getNumThreads(),coarse.rows));
+		  accumulators.resize(nWorkers);
+		  cv::parallel_for_(cv::Range(0,nWorkers),
+			                CircleCenterBody(edges,dx,dy,minR,maxR,nWorkers,accumulators),nWorkers);
+		  int stride= coarse.cols+2;
+		  accumulator.resize((coarse.rows+2)*stride);
+		  cv::parallel_for_(cv::Range(0,coarse.rows+2),CircleReduceBody(accumulators,accumulator,stride,nWorkers));
+
+		  // local maxima having the votes of a partial circle of the smallest radius
+		  int threshold= std::max(3,cvRound(minSupport*2.0*CV_PI*minR/2));
+		  std::vector<CircleCandidate> candidates;
+		  for (int y=0; y<coarse.rows; y++) {
+
+			  for (int x=0; x<coarse.cols; x++) {
+
+				  int base= (y+1)*stride + x+1;
+				  int v= accumulator[base];
+				  if (v>threshold && v>accumulator[base-1] && v>=accumulator[base+1] &&
+					  v>accumulator[base-stride] && v>=accumulator[base+stride]) {
+
+					  CircleCandidate c;
+					  c.center= cv::Point2f(static_cast<float>(x),static_cast<float>(y));
+					  c.radius= 0.0f;
+					  c.votes= v;
+					  c.support= 0.0f;
+					  candidates.push_back(c);
+				  }
+			  }
+		  }
+		  std::sort(candidates.begin(),candidates.end(),
+			        [](const CircleCandidate& a, const CircleCandidate& b) { return a.votes>b.votes; });
+
+		  // no candidate closer than the minimum distance to a stronger one
+		  float coarseDist= static_cast<float>(minDist/scale);
+		  size_t kept= 0;
+		  for (size_t i=0; i<candidates.size(); i++) {
+
+			  bool isolated= true;
+			  for (size_t j=0; j<kept && isolated; j++) {
+
+				  cv::Point2f d= candidates[i].center-candidates[j].center;
+				  isolated= d.x*d.x+d.y*d.y >= coarseDist*coarseDist;
+			  }
+			  if (isolated)
+				  candidates[kept++]= candidates[i];
+		  }
+		  candidates.resize(kept);
+		  centerTime= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+
+		  // radius of each candidate, in parallel
+		  start= cv::getTickCount();
+		  cv::parallel_for_(cv::Range(0,static_cast<int>(candidates.size())),
+			                CircleRadiusBody(edges,candidates,minR,maxR));
+		  kept= 0;
+		  for (size_t i=0; i<candidates.size(); i++)
+			  if (candidates[i].support>=minSupport)
+				  candidates[kept++]= candidates[i];
+		  candidates.resize(kept);
+		  radiusTime= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+
+		  // refinement at full resolution, each candidate in its region
+		  start= cv::getTickCount();
+		  for (size_t i=0; i<candidates.size(); i++) {
+
+			  // pixel centers of the coarse level
+			  candidates[i].center= (candidates[i].center+cv::Point2f(0.5f,0.5f))*scale-cv::Point2f(0.5f,0.5f);
+			  candidates[i].radius*= scale;
+		  }
+		  if (levels>0)
+			  cv::parallel_for_(cv::Range(0,static_cast<int>(candidates.size())),
+				                CircleRefineBody(image,candidates,scale+1.0f,cannyThreshold/2,cannyThreshold));
+
+		  std::sort(candidates.begin(),candidates.end(),
+			        [](const CircleCandidate& a, const CircleCandidate& b) { return a.support>b.support; });
+		  for (size_t i=0; i<candidates.size(); i++) {
+
+			  const CircleCandidate& c= candidates[i];
+			  if (c.support<minSupport || c.radius<minRadius || c.radius>maxRadius)
+				  continue;
+
+			  bool isolated= true;
+			  for (size_t j=0; j<circles.size() && isolated; j++) {
+
+				  float ddx= c.center.x-circles[j][0], ddy= c.center.y-circles[j][1];
+				  isolated= ddx*ddx+ddy*ddy >= minDist*minDist;
+			  }
+			  if (isolated)
+				  circles.push_back(cv::Vec3f(c.center.x,c.center.y,c.radius));
+		  }
+		  refineTime= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+	  }
+
+	  // Time spent (ms) by the last detection in each stage
+	  double getPyramidTime() const { return pyramidTime; }
+	  double getEdgeTime() const { return edgeTime; }
+	  double getCenterTime() const { return centerTime; }
+	  double getRadiusTime() const { return radiusTime; }
+	  double getRefinementTime() const { return refineTime; }
+};
+
+#endif
@@ -0,0 +1,365 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 7 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined CONTOURSET
+#define CONTOURSET
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// The contours of a binary image stored in a single arena.
+// Contour i is the range [offsets[i],offsets[i+1]) of the point arena or,
+// when chain codes are used, a start point and one Freeman code
+// (1 byte instead of 8) per point. Contours are traced with the same
+// border following as cv::findContours (RETR_EXTERNAL or RETR_LIST,
+// CHAIN_APPROX_NONE), and listed in the order they are found in a raster scan
+// (cv::findContours gives the same contours in reverse order).
+class ContourSet {
+
+  private:
+
+	  bool chainCoded;                  // store Freeman codes instead of points
+
+	  std::vector<cv::Point> points;    // points of all contours
+	  std::vector<int> offsets;         // first point of each contour (and end)
+	  std::vector<cv::Point> starts;    // first point of each chain
+	  std::vector<uchar> codes;         // Freeman codes of all chains
+	  std::vector<int> codeOffsets;     // first code of each chain (and end)
+
+	  std::vector<schar> buffer;                // image with a 1-pixel border, reused
+	  mutable std::vector<cv::Point> decoded;   // last decoded chain
+
+	  // Displacement of each Freeman code
+	  static const cv::Point* freemanMoves() {
+
+		  static const cv::Point moves[8]= { cv::Point(1,0), cv::Point(1,-1), cv::Point(0,-1), cv::Point(-1,-1),
+			                                 cv::Point(-1,0), cv::Point(-1,1), cv::Point(0,1), cv::Point(1,1) };
+		  return moves;
+	  }
+
+	  // Follows the border starting at pixel index i0 of the buffer (image point pt),
+	  // marking its pixels: 2, or -126 on the right side of the object
+	  void trace(int i0, bool isHole, cv::Point pt, const int* deltas) {
+
+		  const cv::Point* moves= freemanMoves();
+		  schar* img= &buffer[0];
+
+		  if (chainCoded)
+			  starts.push_back(pt);
+
+		  // first neighbor, turning clockwise
+		  int s, send;
+		  s= send= isHole ? 0 : 4;
+		  int i1;
+		  do {
+			  s= (s-1)&7;
+			  i1= i0+deltas[s];
+		  } while (img[i1]==0 && s!=send);
+
+		  if (s==send) { // isolated pixel
+
+			  img[i0]= -126;
+			  if (!chainCoded)
+				  points.push_back(pt);
+			  return;
+		  }
+
+		  int i3= i0;
+		  int i4= i0;
+		  for (;;) {
+
+			  // next neighbor, turning counterclockwise
+			  send= s;
+			  while (s<15) {
+
+				  i4= i3+deltas[++s];
+				  if (img[i4]!=0)
+					  break;
+			  }
+			  s&= 7;
+
+			  if (static_cast<unsigned>(s-1) < static_cast<unsigned>(send))
+				  img[i3]= -126;
+			  else if (img[i3]==1)
+				  img[i3]= 2;
+
+			  if (chainCoded)
+				  codes.push_back(static_cast<uchar>(s));
+			  else
+				  points.push_back(pt);
+			  pt+= moves[s];
+
+			  if (i4==i0 && i3==i1)
+				  break;
+
+			  i3= i4;
+			  s= (s+4)&7;
+		  }
+	  }
+
+  public:
+
+	  ContourSet() : chainCoded(false) {
+
+		  clear();
+	  }
+
+	  // Stores the contours as chain codes (the current contours are removed)
+	  void setChainCode(bool flag) {
+
+		  chainCoded= flag;
+		  clear();
+	  }
+
+	  bool isChainCoded() const {
+
+		  return chainCoded;
+	  }
+
+	  void clear() {
+
+		  points.clear();
+		  offsets.assign(1,0);
+		  starts.clear();
+		  codes.clear();
+		  codeOffsets.assign(1,0);
+	  }
+
+	  // Finds the contours of a binary image (non-zero pixels are foreground);
+	  // mode is cv::RETR_EXTERNAL or cv::RETR_LIST.
+	  // Unlike cv::findContours, the image is not modified.
+	  void find(const cv::Mat& binary, int mode=cv::RETR_EXTERNAL) {
+
+		  CV_Assert(binary.type()==CV_8UC1);
+		  CV_Assert(mode==cv::RETR_EXTERNAL || mode==cv::RETR_LIST);
+		  clear();
+
+		  // copy with a border of 0s
+		  int w= binary.cols+2;
+		  int h= binary.rows+2;
+		  buffer.assign(w*h,0);
+		  for (int j=0; j<binary.rows; j++) {
+
+			  const uchar* data= binary.ptr<uchar>(j);
+			  schar* row= &buffer[(j+1)*w+1];
+			  for (int i=0; i<binary.cols; i++)
+				  row[i]= data[i]!=0;
+		  }
+
+		  // buffer offsets of the 8 neighbors, in Freeman order, repeated
+		  int deltas[16]= { 1, 1-w, -w, -1-w, -1, w-1, w, w+1 };
+		  std::copy(deltas, deltas+8, deltas+8);
+
+		  const schar* img= &buffer[0];
+		  for (int y=1; y<h-1; y++) {
+
+			  int lnbd= y*w; // last border pixel met on this row
+			  schar prev= 0;
+
+			  for (int x=1; x<w-1; x++) {
+
+				  int index= y*w+x;
+				  schar p= img[index];
+				  if (p==prev)
+					  continue;
+
+				  // outer border (0 then 1) or hole border (object then 0)
+				  bool isHole= false;
+				  bool start= true;
+				  if (!(prev==0 && p==1)) {
+
+					  if (p!=0 || prev<1) {
+
+						  start= false;
+
+					  } else {
+
+						  if (prev & -2)
+							  lnbd= index-1;
+						  isHole= true;
+					  }
+				  }
+
+				  // only the borders that are not inside an object
+				  if (start && mode==cv::RETR_EXTERNAL && (isHole || img[lnbd]>0))
+					  start= false;
+
+				  if (start) {
+
+					  int i0= index-isHole;
+					  trace(i0,isHole,cv::Point(x-isHole-1,y-1),deltas);
+					  if (chainCoded)
+						  codeOffsets.push_back(static_cast<int>(codes.size()));
+					  else
+						  offsets.push_back(static_cast<int>(points.size()));
+					  lnbd= i0;
+					  prev= img[index];
+
+				  } else {
+
+					  prev= p;
+					  if (prev & -2)
+						  lnbd= index;
+				  }
+			  }
+		  }
+	  }
+
+	  // Number of contours
+	  int size() const {
+
+		  return static_cast<int>(chainCoded ? starts.size() : offsets.size()-1);
+	  }
+
+	  // Number of points of contour i
+	  int length(int i) const {
+
+		  if (chainCoded)
+			  return std::max(1,codeOffsets[i+1]-codeOffsets[i]);
+
+		  return offsets[i+1]-offsets[i];
+	  }
+
+	  // Bytes used by the contours
+	  size_t getBytes() const {
+
+		  if (chainCoded)
+			  return starts.size()*sizeof(cv::Point)+codes.size()+codeOffsets.size()*sizeof(int);
+
+		  return points.size()*sizeof(cv::Point)+offsets.size()*sizeof(int);
+	  }
+
+	  // Gets contour i as a Nx1 CV_32SC2 matrix that can be given to
+	  // the shape functions. The points are not copied; a chain is decoded
+	  // in a buffer that is valid until the next call.
+	  cv::Mat getContour(int i) const {
+
+		  if (!chainCoded)
+			  return cv::Mat(length(i),1,CV_32SC2,const_cast<cv::Point*>(&points[offsets[i]]));
+
+		  const cv::Point* moves= freemanMoves();
+		  int n= length(i);
+		  decoded.resize(n);
+		  cv::Point pt= starts[i];
+		  decoded[0]= pt;
+		  const uchar* code= codes.data()+codeOffsets[i];
+		  for (int k=1; k<n; k++) {
+
+			  pt+= moves[code[k-1]];
+			  decoded[k]= pt;
+		  }
+
+		  return cv::Mat(n,1,CV_32SC2,&decoded[0]);
+	  }
+
+	  // Freeman codes of chain i (0 is east, counterclockwise)
+	  const uchar* getCodes(int i) const {
+
+		  CV_Assert(chainCoded);
+		  return codes.data()+codeOffsets[i];
+	  }
+
+	  // Keeps only the contours having between minLength and maxLength points,
+	  // the arena is compacted in place
+	  void filter(int minLength, int maxLength) {
+
+		  int n= size();
+		  int kept= 0;
+		  for (int i=0; i<n; i++) {
+
+			  int len= length(i);
+			  if (len<minLength || len>maxLength)
+				  continue;
+
+			  if (chainCoded) {
+
+				  int first= codeOffsets[i];
+				  int last= codeOffsets[i+1];
+				  starts[kept]= starts[i];
+				  int dst= codeOffsets[kept];
+				  std::copy(codes.begin()+first, codes.begin()+last, codes.begin()+dst);
+				  codeOffsets[kept+1]= dst+last-first;
+
+			  } else {
+
+				  int first= offsets[i];
+				  int last= offsets[i+1];
+				  int dst= offsets[kept];
+				  std::copy(points.begin()+first, points.begin()+last, points.begin()+dst);
+				  offsets[kept+1]= dst+last-first;
+			  }
+			  kept++;
+		  }
+
+		  if (chainCoded) {
+
+			  starts.resize(kept);
+			  codeOffsets.resize(kept+1);
+			  codes.resize(codeOffsets[kept]);
+
+		  } else {
+
+			  offsets.resize(kept+1);
+			  points.resize(offsets[kept]);
+		  }
+	  }
+
+	  // Shape descriptors of contour i
+
+	  cv::Rect boundingRect(int i) const {
+
+		  return cv::boundingRect(getContour(i));
+	  }
+
+	  cv::Moments moments(int i) const {
+
+		  return cv::moments(getContour(i));
+	  }
+
+	  void minEnclosingCircle(int i, cv::Point2f& center, float& radius) const {
+
+		  cv::minEnclosingCircle(getContour(i),center,radius);
+	  }
+
+	  void approxPolyDP(int i, std::vector<cv::Point>& poly, double epsilon, bool closed=true) const {
+
+		  cv::approxPolyDP(getContour(i),poly,epsilon,closed);
+	  }
+
+	  void convexHull(int i, std::vector<cv::Point>& hull) const {
+
+		  cv::convexHull(getContour(i),hull);
+	  }
+
+	  // Draws all contours
+	  void draw(cv::Mat& image, const cv::Scalar& color, int thickness=1) const {
+
+		  for (int i=0; i<size(); i++) {
+
+			  cv::Mat contour= getContour(i);
+			  const cv::Point* pts= contour.ptr<cv::Point>();
+			  int n= contour.rows;
+			  cv::polylines(image,&pts,&n,1,true,color,thickness);
+		  }
+	  }
+};
+
+#endif
@@ -24,6 +24,9 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 
 #include "linefinder.h"
 #include "edgedetector.h"
+#include "tiledCanny.h"
+#include "circleDetector.h"
+#include "shapeFitter.h"
 
 #define PI 3.1415926
 
@@ -55,6 +58,22 @@ int main()
 	cv::namedWindow("Sobel (high threshold)");
 	cv::imshow("Sobel (high threshold)",ed.getBinaryMap(350));
 
+	// Sobel magnitude and orientation in a single pass
+	int64 start= cv::getTickCount();
+	ed.computeSobel(image);
+	double twoPasses= (cv::getTickCount()-start)/cv::getTickFrequency();
+
+	ed.setNumberOfBins(180); // 2 degrees per bin, as getSobelOrientationImage
+	start= cv::getTickCount();
+	ed.computeGradient(image);
+	double fused= (cv::getTickCount()-start)/cv::getTickFrequency();
+	std::cout << "Sobel and cartToPolar: " << twoPasses*1000. << "ms, fused gradient: "
+		      << fused*1000. << "ms" << std::endl;
+
+    // Display the quantized orientation
+	cv::namedWindow("Sobel (orientation bins)");
+	cv::imshow("Sobel (orientation bins)",ed.getOrientationBins());
+
 	// Apply Canny algorithm
 	cv::Mat contours;
 	cv::Canny(image,contours,125,350);
@@ -63,6 +82,25 @@ int main()
 	cv::namedWindow("Canny Contours");
 	cv::imshow("Canny Contours",255-contours);
 
+	// Canny on tiles processed in parallel
+	TiledCanny canny(125,350);
+	cv::Mat tiledContours;
+	start= cv::getTickCount();
+	cv::Canny(image,contours,125,350);
+	double opencv= (cv::getTickCount()-start)/cv::getTickFrequency();
+	start= cv::getTickCount();
+	canny.detect(image,tiledContours);
+	double tiled= (cv::getTickCount()-start)/cv::getTickFrequency();
+	std::cout << "Canny: " << opencv*1000. << "ms, tiled: " << tiled*1000. << "ms ("
+		      << cv::countNonZero(contours!=tiledContours) << " different pixels)" << std::endl;
+
+	// from the derivatives of the fused gradient (reflected borders)
+	cv::Mat sobelX, sobelY;
+	ed.computeGradient(image,sobelX,sobelY);
+	canny.detect(sobelX,sobelY,tiledContours);
+	cv::namedWindow("Canny Contours (tiled)");
+	cv::imshow("Canny Contours (tiled)",255-tiledContours);
+
 	// Create a test image
 	cv::Mat test(200,200,CV_8U,cv::Scalar(0));
 	cv::line(test,cv::Point(100,0),cv::Point(200,200),cv::Scalar(255));
@@ -121,6 +159,50 @@ int main()
 	cv::namedWindow("Lines with Hough");
 	cv::imshow("Lines with Hough",result);
 
+	// Hough transform where each contour pixel votes only around
+	// its gradient orientation (+/- 5 degrees)
+	LineFinder oriented;
+	oriented.setMinVote(50);
+	start= cv::getTickCount();
+	cv::HoughLines(contours,lines,1,PI/180,50);
+	double allAngles= (cv::getTickCount()-start)/cv::getTickFrequency();
+	start= cv::getTickCount();
+	std::vector<cv::Vec2f> orientedLines= oriented.findOrientedLines(contours,ed.getOrientation(),PI/36);
+	double voted= (cv::getTickCount()-start)/cv::getTickFrequency();
+	std::cout << "Hough: " << lines.size() << " lines, " << cv::countNonZero(contours)*180 << " votes, "
+		      << allAngles*1000. << "ms; oriented Hough: " << orientedLines.size() << " lines, "
+		      << oriented.getNumberOfVotes() << " votes, " << voted*1000. << "ms" << std::endl;
+
+	// Lines tracked over a simulated camera motion
+	LineFinder tracker;
+	tracker.setMinVote(60);
+	cv::Mat frame, frameContours;
+	double houghTime= 0., trackTime= 0.;
+	int fullTransforms= 0;
+	for (int f=0; f<30; f++) {
+
+		// image translated by a fraction of pixel per frame
+		cv::Mat shift= (cv::Mat_<double>(2,3) << 1, 0, f*0.5, 0, 1, f*0.25);
+		cv::warpAffine(image,frame,shift,image.size());
+		cv::Canny(frame,frameContours,125,350);
+
+		start= cv::getTickCount();
+		cv::HoughLines(frameContours,lines,1,PI/180,60);
+		houghTime+= (cv::getTickCount()-start)/cv::getTickFrequency();
+
+		start= cv::getTickCount();
+		tracker.trackLines(frameContours);
+		trackTime+= (cv::getTickCount()-start)/cv::getTickFrequency();
+		if (tracker.isFullTransform())
+			fullTransforms++;
+	}
+	std::cout << "30 frames: Hough " << houghTime*1000. << "ms, tracking " << trackTime*1000.
+		      << "ms (" << fullTransforms << " full transforms)" << std::endl;
+
+	tracker.drawTrackedLines(frame);
+	cv::namedWindow("Tracked lines");
+	cv::imshow("Tracked lines",frame);
+
 	// Create LineFinder instance
 	LineFinder ld;
 
@@ -192,6 +274,43 @@ int main()
 	cv::namedWindow("Fitted line");
 	cv::imshow("Fitted line",image);
 
+	// Robust fitting of all the detected lines, one by one and as a batch
+	std::vector<std::vector<cv::Point> > segments(li.size());
+	PointSetArena arena;
+	for (size_t i=0; i<li.size(); i++) {
+
+		cv::Mat segment(contours.size(),CV_8U,cv::Scalar(0));
+		cv::line(segment, cv::Point(li[i][0],li[i][1]),cv::Point(li[i][2],li[i][3]),cv::Scalar(255),3);
+		cv::bitwise_and(contours,segment,segment);
+		cv::findNonZero(segment,segments[i]);
+		arena.add(segments[i]);
+	}
+
+	start= cv::getTickCount();
+	std::vector<cv::Vec4f> fitted(segments.size());
+	for (size_t i=0; i<segments.size(); i++)
+		cv::fitLine(segments[i], fitted[i], cv::DIST_HUBER, 0, 0.01, 0.01);
+	double oneByOne= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+
+	start= cv::getTickCount();
+	RobustFitter fitter(FIT_HUBER);
+	LineFits lineFits;
+	fitter.fitLines(arena, lineFits);
+	double batch= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+	std::cout << arena.size() << " lines (" << arena.points() << " points) fitted: one by one " << oneByOne
+		      << "ms, batch " << batch << "ms" << std::endl;
+
+	image= cv::imread("road.jpg",0);
+	for (int i=0; i<arena.size(); i++) {
+
+		if (lineFits.rms[i]<0.0f)
+			continue;
+		cv::Point2f p(lineFits.x0[i],lineFits.y0[i]), d(lineFits.vx[i],lineFits.vy[i]);
+		cv::line(image, p-d*200.0f, p+d*200.0f, cv::Scalar(0), 2);
+	}
+	cv::namedWindow("Fitted lines (batch)");
+	cv::imshow("Fitted lines (batch)",image);
+
 	// eliminate inconsistent lines
 	ld.removeLinesOfInconsistentOrientations(ed.getOrientation(),0.4,0.1);
 
@@ -251,14 +370,16 @@ int main()
 
 	cv::GaussianBlur(image, image, cv::Size(5, 5), 1.5);
 	std::vector<cv::Vec3f> circles;
+	start= cv::getTickCount();
 	cv::HoughCircles(image, circles, cv::HOUGH_GRADIENT, 
 		2,   // accumulator resolution (size of the image / 2) 
 		20,  // minimum distance between two circles
 		200, // Canny high threshold 
 		60, // minimum number of votes 
 		15, 50); // min and max radius
+	double circleTime= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
 
-	std::cout << "Circles: " << circles.size() << std::endl;
+	std::cout << "Circles: " << circles.size() << " (" << circleTime << "ms)" << std::endl;
 	
 	// Draw the circles
 	image= cv::imread("chariot.jpg",0);
@@ -279,6 +400,65 @@ int main()
 	cv::namedWindow("Detected Circles");
 	cv::imshow("Detected Circles",image);
 
+	// Coarse-to-fine detection: candidates on a reduced level,
+	// refined at full resolution in their region only
+	image= cv::imread("chariot.jpg",0);
+	cv::GaussianBlur(image, image, cv::Size(5, 5), 1.5);
+	CircleDetector circleDetector(15, 50);
+	circleDetector.setMinDistance(20);
+	circleDetector.setCannyThreshold(200);
+	std::vector<cv::Vec3f> refinedCircles;
+	circleDetector.detect(image, refinedCircles);
+
+	std::cout << "Coarse-to-fine circles: " << refinedCircles.size() << std::endl;
+	std::cout << "   pyramid " << circleDetector.getPyramidTime() << "ms, edges " << circleDetector.getEdgeTime()
+		      << "ms, centers " << circleDetector.getCenterTime() << "ms, radii " << circleDetector.getRadiusTime()
+		      << "ms, refinement " << circleDetector.getRefinementTime() << "ms" << std::endl;
+
+	image= cv::imread("chariot.jpg",0);
+	for (size_t i=0; i<refinedCircles.size(); i++)
+		cv::circle(image, cv::Point(cvRound(refinedCircles[i][0]), cvRound(refinedCircles[i][1])),
+			       cvRound(refinedCircles[i][2]), cv::Scalar(255), 2);
+
+	cv::namedWindow("Detected Circles (coarse-to-fine)");
+	cv::imshow("Detected Circles (coarse-to-fine)",image);
+
+	// Circles and ellipses fitted (Tukey) to the edge points around each detected circle
+	cv::Mat edges;
+	image= cv::imread("chariot.jpg",0);
+	cv::GaussianBlur(image, image, cv::Size(5, 5), 1.5);
+	cv::Canny(image, edges, 100, 200);
+	arena.clear();
+	for (size_t i=0; i<refinedCircles.size(); i++) {
+
+		cv::Mat ring(edges.size(),CV_8U,cv::Scalar(0));
+		cv::circle(ring, cv::Point(cvRound(refinedCircles[i][0]), cvRound(refinedCircles[i][1])),
+			       cvRound(refinedCircles[i][2]), cv::Scalar(255), 5);
+		cv::bitwise_and(edges,ring,ring);
+		std::vector<cv::Point> ringPoints;
+		cv::findNonZero(ring,ringPoints);
+		arena.add(ringPoints);
+	}
+
+	fitter.setEstimator(FIT_TUKEY);
+	CircleFits circleFits;
+	EllipseFits ellipseFits;
+	fitter.fitCircles(arena, circleFits);
+	fitter.fitEllipses(arena, ellipseFits);
+
+	image= cv::imread("chariot.jpg",0);
+	for (int i=0; i<arena.size(); i++) {
+
+		if (circleFits.rms[i]>=0.0f)
+			std::cout << "circle (" << circleFits.cx[i] << "," << circleFits.cy[i] << ") r=" << circleFits.radius[i]
+			          << " rms=" << circleFits.rms[i] << std::endl;
+		if (ellipseFits.rms[i]>=0.0f)
+			cv::ellipse(image, cv::RotatedRect(cv::Point2f(ellipseFits.cx[i],ellipseFits.cy[i]),
+				        cv::Size2f(ellipseFits.width[i],ellipseFits.height[i]),ellipseFits.angle[i]), cv::Scalar(255), 2);
+	}
+	cv::namedWindow("Fitted ellipses");
+	cv::imshow("Fitted ellipses",image);
+
 	cv::waitKey();
 	return 0;
 }
\ No newline at end of file
@@ -23,6 +23,209 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// Sobel gradient of a band of rows in a single pass: magnitude (L1 or L2),
+// orientation over [0,2PI) (as cv::cartToPolar), the same orientation quantized
+// into bins and, optionally, the 16-bit derivatives.
+// With the 3x3 aperture the derivatives are computed from the 3 image rows
+// (BORDER_REFLECT_101, as cv::Sobel); otherwise they are given as CV_32F images.
+// The orientation uses a polynomial approximation of atan2 whose
+// error is below 2e-4 radians (0.01 degree), much less than a bin.
+class SobelGradientBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& image;     // CV_8U image (3x3 aperture)
+	const cv::Mat& derivX;    // CV_32F derivatives (other apertures)
+	const cv::Mat& derivY;
+	cv::Mat& magnitude;       // CV_32F
+	cv::Mat& orientation;     // CV_32F, radians
+	cv::Mat& bins;            // CV_8U
+	cv::Mat& sobelX;          // CV_16S derivatives, if not empty (3x3 aperture)
+	cv::Mat& sobelY;
+	bool l2;
+	int nBins;
+
+	static int reflect(int i, int n) {
+
+		if (n==1)
+			return 0;
+		if (i<0)
+			return -i;
+		if (i>=n)
+			return 2*n-2-i;
+		return i;
+	}
+
+	// 3x3 Sobel derivatives of row j
+	void derivatives(int j, short* s, short* d, short* gx, short* gy) const {
+
+		int n= image.cols;
+		const uchar* a= image.ptr<uchar>(reflect(j-1,image.rows));
+		const uchar* b= image.ptr<uchar>(j);
+		const uchar* c= image.ptr<uchar>(reflect(j+1,image.rows));
+
+		// vertical smoothing and difference, in s[1..n] and d[1..n]
+		int i= 0;
+#if CV_SIMD128
+		for (; i<=n-8; i+=8) {
+
+			cv::v_int16x8 va= cv::v_reinterpret_as_s16(cv::v_load_expand(a+i));
+			cv::v_int16x8 vb= cv::v_reinterpret_as_s16(cv::v_load_expand(b+i));
+			cv::v_int16x8 vc= cv::v_reinterpret_as_s16(cv::v_load_expand(c+i));
+			cv::v_store(s+i+1, va + vb + vb + vc);
+			cv::v_store(d+i+1, vc - va);
+		}
+#endif
+		for (; i<n; i++) {
+
+			s[i+1]= static_cast<short>(a[i] + 2*b[i] + c[i]);
+			d[i+1]= static_cast<short>(c[i] - a[i]);
+		}
+
+		// reflected columns
+		s[0]= s[reflect(-1,n)+1];
+		d[0]= d[reflect(-1,n)+1];
+		s[n+1]= s[reflect(n,n)+1];
+		d[n+1]= d[reflect(n,n)+1];
+
+		// horizontal difference and smoothing
+		i= 0;
+#if CV_SIMD128
+		for (; i<=n-8; i+=8) {
+
+			cv::v_store(gx+i, cv::v_load(s+i+2) - cv::v_load(s+i));
+			cv::v_int16x8 vd= cv::v_load(d+i+1);
+			cv::v_store(gy+i, cv::v_load(d+i) + vd + vd + cv::v_load(d+i+2));
+		}
+#endif
+		for (; i<n; i++) {
+
+			gx[i]= static_cast<short>(s[i+2] - s[i]);
+			gy[i]= static_cast<short>(d[i] + 2*d[i+1] + d[i+2]);
+		}
+	}
+
+	// Magnitude, orientation and orientation bin of n pixels
+	void polar(const float* fx, const float* fy, int n, float* mag, float* ori, int* bin) const {
+
+		// atan(t), t in [0,1]
+		const float p1= 0.9997878412794807f, p3= -0.3258083974640975f;
+		const float p5= 0.1555786518463281f, p7= -0.04432655554792128f;
+		const float pi= static_cast<float>(CV_PI);
+		const float scale= nBins/(2.0f*pi);
+
+		int i= 0;
+#if CV_SIMD128
+		cv::v_float32x4 zero= cv::v_setzero_f32(), eps= cv::v_setall_f32(FLT_EPSILON);
+		cv::v_float32x4 halfPi= cv::v_setall_f32(pi/2.0f), vpi= cv::v_setall_f32(pi), twoPi= cv::v_setall_f32(2.0f*pi);
+		cv::v_float32x4 vp1= cv::v_setall_f32(p1), vp3= cv::v_setall_f32(p3);
+		cv::v_float32x4 vp5= cv::v_setall_f32(p5), vp7= cv::v_setall_f32(p7);
+		cv::v_float32x4 vscale= cv::v_setall_f32(scale);
+		cv::v_int32x4 last= cv::v_setall_s32(nBins-1);
+		for (; i<=n-4; i+=4) {
+
+			cv::v_float32x4 x= cv::v_load(fx+i);
+			cv::v_float32x4 y= cv::v_load(fy+i);
+			cv::v_float32x4 ax= cv::v_abs(x), ay= cv::v_abs(y);
+
+			if (l2)
+				cv::v_store(mag+i, cv::v_sqrt(x*x + y*y));
+			else
+				cv::v_store(mag+i, ax + ay);
+
+			cv::v_float32x4 t= cv::v_min(ax,ay)/(cv::v_max(ax,ay)+eps);
+			cv::v_float32x4 t2= t*t;
+			cv::v_float32x4 angle= (((vp7*t2 + vp5)*t2 + vp3)*t2 + vp1)*t;
+			angle= cv::v_select(ay>ax, halfPi-angle, angle);
+			angle= cv::v_select(x<zero, vpi-angle, angle);
+			angle= cv::v_select(y<zero, twoPi-angle, angle);
+			cv::v_store(ori+i, angle);
+			cv::v_store(bin+i, cv::v_min(cv::v_floor(angle*vscale), last));
+		}
+#endif
+		for (; i<n; i++) {
+
+			float x= fx[i], y= fy[i];
+			float ax= std::abs(x), ay= std::abs(y);
+			mag[i]= l2 ? std::sqrt(x*x + y*y) : ax + ay;
+
+			float t= std::min(ax,ay)/(std::max(ax,ay)+FLT_EPSILON);
+			float t2= t*t;
+			float angle= (((p7*t2 + p5)*t2 + p3)*t2 + p1)*t;
+			if (ay>ax) angle= pi/2.0f-angle;
+			if (x<0.0f) angle= pi-angle;
+			if (y<0.0f) angle= 2.0f*pi-angle;
+			ori[i]= angle;
+			bin[i]= std::min(cvFloor(angle*scale), nBins-1);
+		}
+	}
+
+  public:
+
+	SobelGradientBody(const cv::Mat& image, const cv::Mat& derivX, const cv::Mat& derivY,
+		              cv::Mat& magnitude, cv::Mat& orientation, cv::Mat& bins, cv::Mat& sobelX, cv::Mat& sobelY,
+		              bool l2, int nBins)
+		: image(image), derivX(derivX), derivY(derivY), magnitude(magnitude), orientation(orientation), bins(bins),
+		  sobelX(sobelX), sobelY(sobelY), l2(l2), nBins(nBins) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int n= magnitude.cols;
+		std::vector<short> s(n+2), d(n+2), gx(n), gy(n);
+		std::vector<float> fx(n), fy(n);
+		std::vector<int> bin(n);
+
+		for (int j=range.start; j<range.end; j++) {
+
+			const float* x;
+			const float* y;
+			if (derivX.empty()) {
+
+				short* outX= sobelX.empty() ? &gx[0] : sobelX.ptr<short>(j);
+				short* outY= sobelY.empty() ? &gy[0] : sobelY.ptr<short>(j);
+				derivatives(j,&s[0],&d[0],outX,outY);
+
+				// to floats
+				int i= 0;
+#if CV_SIMD128
+				for (; i<=n-8; i+=8) {
+
+					cv::v_int32x4 lo, hi;
+					cv::v_expand(cv::v_load(outX+i),lo,hi);
+					cv::v_store(&fx[i], cv::v_cvt_f32(lo));
+					cv::v_store(&fx[i+4], cv::v_cvt_f32(hi));
+					cv::v_expand(cv::v_load(outY+i),lo,hi);
+					cv::v_store(&fy[i], cv::v_cvt_f32(lo));
+					cv::v_store(&fy[i+4], cv::v_cvt_f32(hi));
+				}
+#endif
+				for (; i<n; i++) {
+
+					fx[i]= outX[i];
+					fy[i]= outY[i];
+				}
+				x= &fx[0];
+				y= &fy[0];
+
+			} else {
+
+				x= derivX.ptr<float>(j);
+				y= derivY.ptr<float>(j);
+			}
+
+			polar(x,y,n,magnitude.ptr<float>(j),orientation.ptr<float>(j),&bin[0]);
+
+			uchar* out= bins.ptr<uchar>(j);
+			for (int i=0; i<n; i++)
+				out[i]= static_cast<uchar>(bin[i]);
+		}
+	}
+};
 
 class EdgeDetector {
 
@@ -43,9 +246,18 @@ class EdgeDetector {
 	  // Sobel orientation
 	  cv::Mat sobelOrientation;
 
+	  // Sobel orientation quantized into bins
+	  cv::Mat sobelBins;
+
+	  // Number of orientation bins
+	  int nBins;
+
+	  // L2 (or L1) magnitude
+	  bool l2Norm;
+
   public:
 
-	  EdgeDetector() : aperture(3) {}
+	  EdgeDetector() : aperture(3), nBins(180), l2Norm(true) {}
 
 	  // Set the aperture size of the kernel
 	  void setAperture(int a) {
@@ -84,6 +296,44 @@ class EdgeDetector {
 		  cv::cartToPolar(sobelX, sobelY, sobelMagnitude, sobelOrientation);
 	  }
 
+	  // Set the number of orientation bins (1 to 256) of computeGradient
+	  void setNumberOfBins(int n) {
+
+		  nBins= std::min(std::max(n,1),256);
+	  }
+
+	  // Get the number of orientation bins
+	  int getNumberOfBins() const {
+
+		  return nBins;
+	  }
+
+	  // Use the L2 norm (or the L1 norm) for the magnitude of computeGradient
+	  void setL2Norm(bool flag) {
+
+		  l2Norm= flag;
+	  }
+
+	  // Compute the Sobel magnitude, orientation and orientation bins in a single pass
+	  void computeGradient(const cv::Mat& image) {
+
+		  cv::Mat noX, noY;
+		  computeGradient(image,noX,noY,false);
+	  }
+
+	  // Compute the Sobel magnitude, orientation and orientation bins in a single pass,
+	  // and get the derivatives (CV_16S)
+	  void computeGradient(const cv::Mat& image, cv::Mat &sobelX, cv::Mat &sobelY) {
+
+		  computeGradient(image,sobelX,sobelY,true);
+	  }
+
+	  // Get the quantized Sobel orientation (CV_8U)
+	  cv::Mat getOrientationBins() {
+
+		  return sobelBins;
+	  }
+
 	  // Get Sobel magnitude
 	  cv::Mat getMagnitude() {
 
@@ -128,6 +378,46 @@ class EdgeDetector {
 		  return bin;
 	  }
 
+  private:
+
+	  void computeGradient(const cv::Mat& image, cv::Mat &sobelX, cv::Mat &sobelY, bool derivatives) {
+
+		  CV_Assert(image.type()==CV_8UC1);
+
+		  sobelMagnitude.create(image.size(),CV_32F);
+		  sobelOrientation.create(image.size(),CV_32F);
+		  sobelBins.create(image.size(),CV_8U);
+
+		  if (aperture==3) {
+
+			  // the derivatives are computed with the magnitude
+			  if (derivatives) {
+
+				  sobelX.create(image.size(),CV_16S);
+				  sobelY.create(image.size(),CV_16S);
+			  }
+
+			  cv::Mat none;
+			  cv::parallel_for_(cv::Range(0,image.rows),
+				                SobelGradientBody(image,none,none,sobelMagnitude,sobelOrientation,sobelBins,
+								                  sobelX,sobelY,l2Norm,nBins));
+
+		  } else {
+
+			  cv::Mat derivX, derivY, none;
+			  cv::Sobel(image, derivX, CV_32F, 1, 0, aperture);
+			  cv::Sobel(image, derivY, CV_32F, 0, 1, aperture);
+			  cv::parallel_for_(cv::Range(0,image.rows),
+				                SobelGradientBody(image,derivX,derivY,sobelMagnitude,sobelOrientation,sobelBins,
+								                  none,none,l2Norm,nBins));
+			  if (derivatives) {
+
+				  derivX.convertTo(sobelX,CV_16S);
+				  derivY.convertTo(sobelY,CV_16S);
+			  }
+		  }
+	  }
+
 };
 
 
@@ -21,8 +21,176 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
 #define PI 3.1415926
 
+// Hough votes of the edge pixels, each worker filling its own range of angles
+// of the shared accumulator, so that no reduction is needed. A pixel votes only
+// for the angles within plus or minus window bins of the normal given by its
+// gradient orientation (modulo PI, the rho of the wrapped angles is then negated
+// by the table); the pixels are sorted by the first angle they vote for, so
+// that the pixels voting for an angle are those of the span bins before it.
+// The accumulator is stored as in cv::HoughLines: (numAngle+2)x(numRho+2) integers.
+class OrientedHoughBody : public cv::ParallelLoopBody {
+
+	const std::vector<cv::Point>& points;    // sorted by first angle
+	const std::vector<int>& binStarts;       // numAngle+1 offsets in points
+	const std::vector<float>& tabCos;        // cos/deltaRho of each angle
+	const std::vector<float>& tabSin;
+	int numRho;
+	int span;                                // angles voted for by each pixel
+	int nWorkers;
+	std::vector<int>& accumulator;
+
+  public:
+
+	OrientedHoughBody(const std::vector<cv::Point>& points, const std::vector<int>& binStarts,
+		              const std::vector<float>& tabCos, const std::vector<float>& tabSin,
+		              int numRho, int span, int nWorkers, std::vector<int>& accumulator)
+		: points(points), binStarts(binStarts), tabCos(tabCos), tabSin(tabSin),
+		  numRho(numRho), span(span), nWorkers(nWorkers), accumulator(accumulator) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int numAngle= static_cast<int>(tabCos.size());
+		int stride= numRho+2;
+
+		for (int w=range.start; w<range.end; w++) {
+
+			for (int n=w*numAngle/nWorkers; n<(w+1)*numAngle/nWorkers; n++) {
+
+				int* acc= &accumulator[(n+1)*stride];
+				std::fill(acc,acc+stride,0);
+				float c= tabCos[n], s= tabSin[n];
+				int offset= (numRho-1)/2 + 1;
+
+				// the pixels whose first angle is one of the span bins up to n
+				for (int k=0; k<span; k++) {
+
+					int b= n-k<0 ? n-k+numAngle : n-k;
+					for (int i=binStarts[b]; i<binStarts[b+1]; i++)
+						acc[cvRound(points[i].x*c + points[i].y*s) + offset]++;
+				}
+			}
+		}
+	}
+};
+
+// A line (rho,theta) followed from frame to frame
+struct TrackedLine {
+
+	int id;        // stable identifier
+	float rho;
+	float theta;
+	int votes;     // votes in the last frame
+	int missed;    // consecutive frames without enough votes
+};
+
+// Hough votes of the edge points restricted, for each tracked line,
+// to a window of angle and distance bins around this line.
+// Points that cannot fall into the window are rejected first with
+// a bound on their distance to the line. Lines are processed in parallel,
+// each with its own small accumulator, and moved to their best bin.
+class LineTrackingBody : public cv::ParallelLoopBody {
+
+	const std::vector<cv::Point>& points;
+	std::vector<TrackedLine>& lines;
+	std::vector<std::vector<int> >& accumulators;   // one per line
+	double deltaRho, deltaTheta;
+	int rhoWindow, thetaWindow;                      // bins on each side
+
+  public:
+
+	LineTrackingBody(const std::vector<cv::Point>& points, std::vector<TrackedLine>& lines,
+		             std::vector<std::vector<int> >& accumulators, double deltaRho, double deltaTheta,
+		             int rhoWindow, int thetaWindow)
+		: points(points), lines(lines), accumulators(accumulators), deltaRho(deltaRho),
+		  deltaTheta(deltaTheta), rhoWindow(rhoWindow), thetaWindow(thetaWindow) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nt= 2*thetaWindow+1;
+		int nr= 2*rhoWindow+1;
+		std::vector<float> tabCos(nt), tabSin(nt);
+
+		for (int i=range.start; i<range.end; i++) {
+
+			TrackedLine& line= lines[i];
+			std::vector<int>& acc= accumulators[i];
+			acc.assign(nt*nr,0);
+
+			for (int k=0; k<nt; k++) {
+
+				double angle= line.theta+(k-thetaWindow)*deltaTheta;
+				tabCos[k]= static_cast<float>(std::cos(angle)/deltaRho);
+				tabSin[k]= static_cast<float>(std::sin(angle)/deltaRho);
+			}
+
+			// a point at distance d from the line and at s along it can only
+			// vote in the window if |d| is below this bound
+			float c= static_cast<float>(std::cos(line.theta));
+			float sn= static_cast<float>(std::sin(line.theta));
+			double span= thetaWindow*deltaTheta;
+			float cosSpan= static_cast<float>(std::cos(span));
+			float sinSpan= static_cast<float>(std::sin(span));
+			float base= static_cast<float>(((rhoWindow+0.5)*deltaRho + std::abs(line.rho)*(1.0-std::cos(span)))/std::cos(span));
+			float rho0= line.rho/static_cast<float>(deltaRho);
+
+			for (size_t p=0; p<points.size(); p++) {
+
+				float x= static_cast<float>(points[p].x);
+				float y= static_cast<float>(points[p].y);
+				float d= x*c + y*sn - line.rho;
+				float s= y*c - x*sn;
+				if (std::abs(d) > base + std::abs(s)*sinSpan/cosSpan)
+					continue;
+
+				for (int k=0; k<nt; k++) {
+
+					int r= cvRound(x*tabCos[k] + y*tabSin[k] - rho0) + rhoWindow;
+					if (r>=0 && r<nr)
+						acc[k*nr+r]++;
+				}
+			}
+
+			// best bin, the closest to the center in case of a tie
+			int best= thetaWindow*nr+rhoWindow;
+			for (int k=0; k<nt; k++) {
+
+				for (int r=0; r<nr; r++) {
+
+					int v= acc[k*nr+r];
+					int distance= std::abs(k-thetaWindow)+std::abs(r-rhoWindow);
+					int bestDistance= std::abs(best/nr-thetaWindow)+std::abs(best%nr-rhoWindow);
+					if (v>acc[best] || (v==acc[best] && distance<bestDistance))
+						best= k*nr+r;
+				}
+			}
+
+			line.votes= acc[best];
+			line.theta+= static_cast<float>((best/nr-thetaWindow)*deltaTheta);
+			line.rho+= static_cast<float>((best%nr-rhoWindow)*deltaRho);
+
+			// back to [0,PI)
+			if (line.theta<0.0f) {
+
+				line.theta+= static_cast<float>(CV_PI);
+				line.rho= -line.rho;
+
+			} else if (line.theta>=static_cast<float>(CV_PI)) {
+
+				line.theta-= static_cast<float>(CV_PI);
+				line.rho= -line.rho;
+			}
+		}
+	}
+};
+
 class LineFinder {
 
   private:
@@ -48,11 +216,108 @@ class LineFinder {
 	  // max allowed gap along the line
 	  double maxGap;
 
+	  // accumulator of the oriented Hough transform, and its edge pixels
+	  // sorted by the first angle they vote for
+	  std::vector<int> accumulator;
+	  std::vector<float> tabCos, tabSin;
+	  std::vector<cv::Point> edgePixels, orientedPoints;
+	  std::vector<int> pointBins, binStarts;
+	  long long votes;
+
+	  // lines tracked from frame to frame
+	  std::vector<TrackedLine> tracked;
+	  std::vector<std::vector<int> > trackAccumulators;
+	  std::vector<cv::Point> edgePoints;
+	  int rhoWindow, thetaWindow;  // tracking window, in bins on each side
+	  int refreshPeriod;           // frames between two full transforms
+	  int maxLines;                // lines detected by a full transform
+	  int maxMissed;               // frames a line can be missed before being dropped
+	  int nextId;
+	  int framesSinceFull;
+	  bool fullTransform;          // last frame used a full transform
+
+	  // Same line, within the tracking window (theta is modulo PI)
+	  bool isClose(const TrackedLine& l1, float rho, float theta) const {
+
+		  double dTheta= std::abs(l1.theta-theta);
+		  double dRho= std::abs(l1.rho-rho);
+		  if (dTheta>CV_PI/2) { // wrapped around, the rho are opposed
+
+			  dTheta= CV_PI-dTheta;
+			  dRho= std::abs(l1.rho+rho);
+		  }
+
+		  return dTheta<=thetaWindow*deltaTheta && dRho<=rhoWindow*deltaRho;
+	  }
+
+	  // Votes of the edge points around each tracked line
+	  void refineTrackedLines() {
+
+		  trackAccumulators.resize(tracked.size());
+		  cv::parallel_for_(cv::Range(0,static_cast<int>(tracked.size())),
+			                LineTrackingBody(edgePoints,tracked,trackAccumulators,deltaRho,deltaTheta,
+							                 rhoWindow,thetaWindow));
+	  }
+
+	  // Full Hough transform, the lines found are matched with the tracked ones
+	  void detectTrackedLines(const cv::Mat& binary) {
+
+		  std::vector<cv::Vec2f> found;
+		  cv::HoughLines(binary,found,deltaRho,deltaTheta,minVote);
+
+		  // strongest lines first; those close to a stronger one are ignored
+		  std::vector<TrackedLine> detected;
+		  for (size_t i=0; i<found.size() && static_cast<int>(detected.size())<maxLines; i++) {
+
+			  bool duplicate= false;
+			  for (size_t j=0; j<detected.size() && !duplicate; j++)
+				  duplicate= isClose(detected[j],found[i][0],found[i][1]);
+			  if (duplicate)
+				  continue;
+
+			  TrackedLine line;
+			  line.id= -1;
+			  line.rho= found[i][0];
+			  line.theta= found[i][1];
+			  line.votes= 0;
+			  line.missed= 0;
+
+			  // keeps the identifier of the tracked line it matches
+			  for (size_t j=0; j<tracked.size(); j++) {
+
+				  if (tracked[j].id>=0 && isClose(tracked[j],line.rho,line.theta)) {
+
+					  line.id= tracked[j].id;
+					  tracked[j].id= -1;
+					  break;
+				  }
+			  }
+			  if (line.id<0)
+				  line.id= nextId++;
+
+			  detected.push_back(line);
+		  }
+
+		  // lines not found again are kept for a few frames
+		  for (size_t j=0; j<tracked.size(); j++) {
+
+			  if (tracked[j].id>=0 && ++tracked[j].missed<=maxMissed)
+				  detected.push_back(tracked[j]);
+		  }
+
+		  tracked.swap(detected);
+		  refineTrackedLines();
+		  framesSinceFull= 0;
+		  fullTransform= true;
+	  }
+
   public:
 
 	  // Default accumulator resolution is 1 pixel by 1 degree
 	  // no gap, no mimimum length
-	  LineFinder() : deltaRho(1), deltaTheta(PI/180), minVote(10), minLength(0.), maxGap(0.) {}
+	  LineFinder() : deltaRho(1), deltaTheta(PI/180), minVote(10), minLength(0.), maxGap(0.), votes(0),
+		             rhoWindow(4), thetaWindow(2), refreshPeriod(15), maxLines(10), maxMissed(2),
+		             nextId(0), framesSinceFull(0), fullTransform(false) {}
 
 	  // Set the resolution of the accumulator
 	  void setAccResolution(double dRho, double dTheta) {
@@ -83,6 +348,237 @@ class LineFinder {
 		  return lines;
 	  }
 
+	  // Apply the Hough Transform where each edge pixel only votes for the
+	  // lines whose normal is within plus or minus delta of its gradient orientation
+	  // (in radians, e.g. EdgeDetector::getOrientation).
+	  // Lines are given as (rho,theta), as with cv::HoughLines, which gives
+	  // the same lines when delta is PI/2 or more.
+	  std::vector<cv::Vec2f> findOrientedLines(const cv::Mat& binary, const cv::Mat& orientations, double delta) {
+
+		  CV_Assert(binary.type()==CV_8UC1);
+		  CV_Assert(orientations.type()==CV_32FC1 && orientations.size()==binary.size());
+
+		  // angle and distance tables, as in cv::HoughLines
+		  int numAngle= cvFloor(CV_PI/deltaTheta)+1;
+		  if (numAngle>1 && std::fabs(CV_PI-(numAngle-1)*deltaTheta)<deltaTheta/2)
+			  numAngle--;
+		  int numRho= cvRound(((binary.cols+binary.rows)*2+1)/deltaRho);
+		  int stride= numRho+2;
+		  float irho= static_cast<float>(1./deltaRho);
+		  tabCos.resize(numAngle);
+		  tabSin.resize(numAngle);
+		  float angle= 0.f;
+		  for (int n=0; n<numAngle; angle+= static_cast<float>(deltaTheta), n++) {
+
+			  tabSin[n]= static_cast<float>(std::sin(static_cast<double>(angle))*irho);
+			  tabCos[n]= static_cast<float>(std::cos(static_cast<double>(angle))*irho);
+		  }
+
+		  // edge pixels sorted by the first angle they vote for (counting sort)
+		  int window= cvRound(delta/deltaTheta);
+		  // all the angles if the window covers them
+		  int span= std::min(2*window+1,numAngle);
+		  edgePixels.clear();
+		  pointBins.clear();
+		  binStarts.assign(numAngle+1,0);
+		  for (int y=0; y<binary.rows; y++) {
+
+			  const uchar* data= binary.ptr<uchar>(y);
+			  const float* ori= orientations.ptr<float>(y);
+
+			  for (int x=0; x<binary.cols; x++) {
+
+				  if (!data[x])
+					  continue;
+
+				  int n= 0;
+				  if (span<numAngle) {
+
+					  double normal= std::fmod(static_cast<double>(ori[x]),CV_PI);
+					  if (normal<0.0)
+						  normal+= CV_PI;
+					  n= (cvRound(normal/deltaTheta)-window)%numAngle;
+					  if (n<0)
+						  n+= numAngle;
+				  }
+				  edgePixels.push_back(cv::Point(x,y));
+				  pointBins.push_back(n);
+				  binStarts[n+1]++;
+			  }
+		  }
+		  for (int n=0; n<numAngle; n++)
+			  binStarts[n+1]+= binStarts[n];
+		  orientedPoints.resize(edgePixels.size());
+		  std::vector<int> next(binStarts.begin(),binStarts.end()-1);
+		  for (size_t i=0; i<edgePixels.size(); i++)
+			  orientedPoints[next[pointBins[i]]++]= edgePixels[i];
+		  votes= static_cast<long long>(edgePixels.size())*span;
+
+		  // votes in parallel ranges of angles, each worker clearing its own rows
+		  int nWorkers= std::max(1,std::min(cv::getNumThreads(),numAngle));
+		  accumulator.resize((numAngle+2)*stride);
+		  std::fill(accumulator.begin(),accumulator.begin()+stride,0);
+		  std::fill(accumulator.end()-stride,accumulator.end(),0);
+		  cv::parallel_for_(cv::Range(0,nWorkers),
+			                OrientedHoughBody(orientedPoints,binStarts,tabCos,tabSin,numRho,span,
+							                  nWorkers,accumulator),nWorkers);
+
+		  // local maxima above the minimum number of votes
+		  std::vector<int> peaks;
+		  for (int n=0; n<numAngle; n++) {
+
+			  for (int r=0; r<numRho; r++) {
+
+				  int base= (n+1)*stride + r+1;
+				  int v= accumulator[base];
+				  if (v>minVote && v>accumulator[base-1] && v>=accumulator[base+1] &&
+					  v>accumulator[base-stride] && v>=accumulator[base+stride])
+					  peaks.push_back(base);
+			  }
+		  }
+
+		  // by decreasing number of votes
+		  const std::vector<int>& acc= accumulator;
+		  std::sort(peaks.begin(),peaks.end(),
+			        [&acc](int a, int b) { return acc[a]>acc[b] || (acc[a]==acc[b] && a<b); });
+
+		  std::vector<cv::Vec2f> found;
+		  for (size_t i=0; i<peaks.size(); i++) {
+
+			  int n= peaks[i]/stride-1;
+			  int r= peaks[i]%stride-1;
+			  found.push_back(cv::Vec2f(static_cast<float>((r-(numRho-1)/2)*deltaRho),
+				                        static_cast<float>(n*deltaTheta)));
+		  }
+
+		  return found;
+	  }
+
+	  // Number of votes cast by the last oriented Hough Transform
+	  long long getNumberOfVotes() const {
+
+		  return votes;
+	  }
+
+	  // Set the tracking window, in accumulator bins on each side of a line
+	  void setTrackingWindow(int rhoBins, int thetaBins) {
+
+		  rhoWindow= std::max(rhoBins,1);
+		  thetaWindow= std::max(thetaBins,1);
+	  }
+
+	  // Set the number of frames between two full transforms,
+	  // the maximum number of lines tracked, and the number of frames
+	  // a line can be missed before being dropped
+	  void setTracking(int period, int lines, int missed) {
+
+		  refreshPeriod= std::max(period,1);
+		  maxLines= lines;
+		  maxMissed= missed;
+	  }
+
+	  // Forget the tracked lines
+	  void resetTracking() {
+
+		  tracked.clear();
+		  framesSinceFull= 0;
+	  }
+
+	  // Follow the lines of the previous frame: each one only receives
+	  // the votes falling in a window around it. A full Hough Transform
+	  // is applied periodically, when no line is tracked and when a line has
+	  // lost its support; lines keep their identifier from frame to frame.
+	  const std::vector<TrackedLine>& trackLines(const cv::Mat& binary) {
+
+		  CV_Assert(binary.type()==CV_8UC1);
+
+		  edgePoints.clear();
+		  for (int y=0; y<binary.rows; y++) {
+
+			  const uchar* data= binary.ptr<uchar>(y);
+			  for (int x=0; x<binary.cols; x++)
+				  if (data[x])
+					  edgePoints.push_back(cv::Point(x,y));
+		  }
+
+		  fullTransform= false;
+		  if (tracked.empty() || ++framesSinceFull>=refreshPeriod) {
+
+			  detectTrackedLines(binary);
+
+		  } else {
+
+			  refineTrackedLines();
+
+			  // a line that loses its support triggers a full transform
+			  bool lost= false;
+			  for (size_t i=0; i<tracked.size(); i++) {
+
+				  if (tracked[i].votes>minVote)
+					  tracked[i].missed= 0;
+				  else if (tracked[i].missed==0)
+					  lost= true;
+			  }
+
+			  if (lost) {
+
+				  detectTrackedLines(binary);
+				  return tracked;
+			  }
+
+			  // lines already missed are dropped after a few frames
+			  size_t kept= 0;
+			  for (size_t i=0; i<tracked.size(); i++)
+				  if (tracked[i].missed==0 || ++tracked[i].missed<=maxMissed)
+					  tracked[kept++]= tracked[i];
+			  tracked.resize(kept);
+
+			  // lines that have converged to the same one
+			  for (size_t i=0; i<tracked.size(); i++) {
+
+				  for (size_t j=i+1; j<tracked.size(); j++) {
+
+					  if (isClose(tracked[i],tracked[j].rho,tracked[j].theta)) {
+
+						  if (tracked[j].votes>tracked[i].votes)
+							  std::swap(tracked[i],tracked[j]);
+						  tracked.erase(tracked.begin()+j);
+						  j--;
+					  }
+				  }
+			  }
+		  }
+
+		  return tracked;
+	  }
+
+	  // The last frame was processed by a full transform
+	  bool isFullTransform() const {
+
+		  return fullTransform;
+	  }
+
+	  // Draw the tracked lines on an image, with their identifier
+	  void drawTrackedLines(cv::Mat &image, cv::Scalar color=cv::Scalar(255,255,255)) {
+
+		  double length= image.cols+image.rows;
+		  for (size_t i=0; i<tracked.size(); i++) {
+
+			  double c= std::cos(tracked[i].theta), s= std::sin(tracked[i].theta);
+			  cv::Point2d foot(tracked[i].rho*c, tracked[i].rho*s);
+			  cv::Point pt1(cvRound(foot.x-length*s), cvRound(foot.y+length*c));
+			  cv::Point pt2(cvRound(foot.x+length*s), cvRound(foot.y-length*c));
+			  cv::line(image,pt1,pt2,color);
+
+			  // identifier near the point of the line closest to the image center
+			  cv::Point2d center(image.cols/2., image.rows/2.);
+			  double t= (center.x-foot.x)*(-s) + (center.y-foot.y)*c;
+			  cv::putText(image,std::to_string(tracked[i].id),
+				          cv::Point(cvRound(foot.x-t*s),cvRound(foot.y+t*c)),
+				          cv::FONT_HERSHEY_PLAIN,1.0,color);
+		  }
+	  }
+
 	  // Draw the detected lines on an image
 	  void drawDetectedLines(cv::Mat &image, cv::Scalar color=cv::Scalar(255,255,255)) {
 	
@@ -0,0 +1,543 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 7 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined SHAPEFITTER
+#define SHAPEFITTER
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Many point sets stored one after the other:
+// x and y coordinates in two arrays, and the offset of each set.
+class PointSetArena {
+
+	std::vector<float> xs, ys;
+	std::vector<int> offsets;   // set i is [offsets[i],offsets[i+1])
+
+  public:
+
+	PointSetArena() : offsets(1,0) {}
+
+	void clear() {
+
+		xs.clear();
+		ys.clear();
+		offsets.assign(1,0);
+	}
+
+	void reserve(int sets, int points) {
+
+		offsets.reserve(sets+1);
+		xs.reserve(points);
+		ys.reserve(points);
+	}
+
+	// Adds a set of points and returns its index
+	template <typename T>
+	int add(const std::vector<cv::Point_<T> >& points) {
+
+		for (size_t i=0; i<points.size(); i++) {
+
+			xs.push_back(static_cast<float>(points[i].x));
+			ys.push_back(static_cast<float>(points[i].y));
+		}
+		offsets.push_back(static_cast<int>(xs.size()));
+
+		return static_cast<int>(offsets.size())-2;
+	}
+
+	// Number of sets
+	int size() const { return static_cast<int>(offsets.size())-1; }
+
+	// Total number of points
+	int points() const { return static_cast<int>(xs.size()); }
+
+	int offset(int i) const { return offsets[i]; }
+	int size(int i) const { return offsets[i+1]-offsets[i]; }
+	const float* x(int i) const { return xs.data()+offsets[i]; }
+	const float* y(int i) const { return ys.data()+offsets[i]; }
+};
+
+// Fitted shapes, one array per parameter (one entry per set),
+// and the signed residual and final weight of each point (arena layout).
+// A negative rms marks a set that could not be fitted.
+struct FitResiduals {
+
+	std::vector<float> rms;        // weighted rms residual of each set
+	std::vector<float> residuals;  // distance of each point to its shape
+	std::vector<float> weights;    // M-estimator weight of each point
+
+	void resize(int sets, int points) {
+
+		rms.resize(sets);
+		residuals.resize(points);
+		weights.resize(points);
+	}
+};
+
+// Lines as returned by cv::fitLine: direction (vx,vy) and a point (x0,y0)
+struct LineFits : FitResiduals {
+
+	std::vector<float> vx, vy, x0, y0;
+};
+
+struct CircleFits : FitResiduals {
+
+	std::vector<float> cx, cy, radius;
+};
+
+// Ellipses as a cv::RotatedRect: center, full axes lengths and angle (degrees)
+struct EllipseFits : FitResiduals {
+
+	std::vector<float> cx, cy, width, height, angle;
+};
+
+enum FitShape { FIT_LINE, FIT_CIRCLE, FIT_ELLIPSE };
+enum FitEstimator { FIT_L2, FIT_HUBER, FIT_TUKEY };
+
+// Fits one shape to each set of a range, by iteratively reweighted least squares.
+// The points of a set are centered and scaled to unit rms radius, then
+// each iteration accumulates the weighted moments (up to degree 2, 3 or 4),
+// solves for the shape, and reweights the points with Huber or Tukey
+// on their residuals (scale from the median absolute residual).
+// Lines are total least squares, circles algebraic (Kasa) and ellipses
+// direct (Fitzgibbon, as formulated by Halir and Flusser); residuals
+// are the distances to the line, to the circle and the Sampson distances.
+class RobustFitBody : public cv::ParallelLoopBody {
+
+	const PointSetArena& arena;
+	int shape;
+	int estimator;
+	float c;                  // tuning constant, in residual scales
+	int maxIterations;
+	float* params[5];         // output arrays of the parameters
+	FitResiduals& fits;
+
+	// index of the moment of u^a*v^b
+	static int moment(int a, int b) {
+
+		return (a+b)*(a+b+1)/2+b;
+	}
+
+	// Weighted moments of all degrees up to 2, 3 or 4
+	static void moments(const float* u, const float* v, const float* w, int n, int degree, double m[15]) {
+
+		std::fill(m,m+15,0.0);
+
+		int i= 0;
+#if CV_SIMD128
+		cv::v_float32x4 acc[15];
+		for (int k=0; k<15; k++)
+			acc[k]= cv::v_setzero_f32();
+		for (; i<=n-4; i+=4) {
+
+			cv::v_float32x4 vu= cv::v_load(u+i), vv= cv::v_load(v+i), vw= cv::v_load(w+i);
+			cv::v_float32x4 wu= vw*vu, wv= vw*vv;
+			cv::v_float32x4 wuu= wu*vu, wuv= wu*vv, wvv= wv*vv;
+			acc[0]+= vw; acc[1]+= wu; acc[2]+= wv;
+			acc[3]+= wuu; acc[4]+= wuv; acc[5]+= wvv;
+			if (degree>=3) {
+
+				cv::v_float32x4 wuuu= wuu*vu, wvvv= wvv*vv;
+				acc[6]+= wuuu; acc[7]+= wuu*vv; acc[8]+= wuv*vv; acc[9]+= wvvv;
+				if (degree>=4) {
+
+					acc[10]+= wuuu*vu; acc[11]+= wuuu*vv; acc[12]+= wuu*vv*vv;
+					acc[13]+= wvvv*vu; acc[14]+= wvvv*vv;
+				}
+			}
+		}
+		for (int k=0; k<15; k++)
+			m[k]= cv::v_reduce_sum(acc[k]);
+#endif
+		int nMoments= (degree+1)*(degree+2)/2;
+		for (; i<n; i++) {
+
+			double pu= 1.0;
+			for (int a=0; a<=degree; a++) {
+
+				double p= w[i]*pu;
+				for (int b=0; a+b<=degree; b++) {
+
+					m[moment(a,b)]+= p;
+					p*= v[i];
+				}
+				pu*= u[i];
+			}
+		}
+		std::fill(m+nMoments,m+15,0.0);
+	}
+
+	// Line n.p=d through the weighted centroid, normal (p[0],p[1]), p[2]=d
+	static bool solveLine(const double m[15], double p[6]) {
+
+		if (m[0]<=0.0)
+			return false;
+
+		double cu= m[1]/m[0], cv= m[2]/m[0];
+		double cuu= m[3]/m[0]-cu*cu, cuv= m[4]/m[0]-cu*cv, cvv= m[5]/m[0]-cv*cv;
+		double theta= 0.5*std::atan2(2.0*cuv,cuu-cvv);    // direction of largest spread
+		p[0]= -std::sin(theta);
+		p[1]= std::cos(theta);
+		p[2]= p[0]*cu+p[1]*cv;
+
+		return true;
+	}
+
+	// Circle u^2+v^2+D*u+E*v+F=0, minimizing the weighted algebraic distance
+	static bool solveCircle(const double m[15], double p[6]) {
+
+		cv::Matx33d a(m[3],m[4],m[1],
+			          m[4],m[5],m[2],
+			          m[1],m[2],m[0]);
+		cv::Vec3d b(-(m[6]+m[8]),-(m[7]+m[9]),-(m[3]+m[5]));
+		cv::Vec3d x;
+		if (!cv::solve(a,b,x,cv::DECOMP_CHOLESKY))
+			return false;
+
+		p[0]= -0.5*x[0];
+		p[1]= -0.5*x[1];
+		double r2= p[0]*p[0]+p[1]*p[1]-x[2];
+		if (r2<=0.0)
+			return false;
+		p[2]= std::sqrt(r2);
+
+		return true;
+	}
+
+	// Conic A*u^2+B*uv+C*v^2+D*u+E*v+F=0 under the constraint 4AC-B^2=1.
+	// The reduced scatter M of the quadratic terms is diagonalized (V,L), so that
+	// M*a=lambda*C1*a becomes the symmetric problem L^-1/2*V'*C1*V*L^-1/2*b=b/lambda.
+	static bool solveEllipse(const double m[15], double p[6]) {
+
+		cv::Matx33d s1(m[10],m[11],m[12],
+			           m[11],m[12],m[13],
+			           m[12],m[13],m[14]);
+		cv::Matx33d s2(m[6],m[7],m[3],
+			           m[7],m[8],m[4],
+			           m[8],m[9],m[5]);
+		cv::Matx33d s3(m[3],m[4],m[1],
+			           m[4],m[5],m[2],
+			           m[1],m[2],m[0]);
+		cv::Matx33d s3inv;
+		if (cv::invert(s3,s3inv,cv::DECOMP_CHOLESKY)==0.0)
+			return false;
+		cv::Matx33d t= -(s3inv*s2.t());
+		cv::Matx33d reduced= s1+s2*t;
+		reduced= 0.5*(reduced+reduced.t());
+
+		cv::Matx31d lambdas;
+		cv::Matx33d vectors;
+		cv::eigen(reduced,lambdas,vectors);   // eigenvectors in rows
+		if (lambdas(0)<=0.0)
+			return false;
+
+		cv::Matx33d w;   // V*L^-1/2
+		for (int i=0; i<3; i++) {
+
+			double s= 1.0/std::sqrt(std::max(lambdas(i),lambdas(0)*1e-12));
+			for (int j=0; j<3; j++)
+				w(j,i)= vectors(i,j)*s;
+		}
+		cv::Matx33d c1(0.0,0.0,2.0,
+			           0.0,-1.0,0.0,
+			           2.0,0.0,0.0);
+		cv::Matx33d k= w.t()*c1*w;
+		k= 0.5*(k+k.t());
+
+		// the ellipse has the only positive eigenvalue
+		cv::Matx31d mus;
+		cv::Matx33d bs;
+		cv::eigen(k,mus,bs);
+		if (mus(0)<=0.0)
+			return false;
+		cv::Vec3d a1= w*cv::Vec3d(bs(0,0),bs(0,1),bs(0,2));
+		cv::Vec3d a2= t*a1;
+		for (int i=0; i<3; i++) {
+
+			p[i]= a1[i];
+			p[i+3]= a2[i];
+		}
+
+		return 4.0*p[0]*p[2]-p[1]*p[1]>0.0;
+	}
+
+	// Signed residuals of n points
+	void residuals(const float* u, const float* v, int n, const double p[6], float* r) const {
+
+		for (int i=0; i<n; i++) {
+
+			if (shape==FIT_LINE) {
+
+				r[i]= static_cast<float>(p[0]*u[i]+p[1]*v[i]-p[2]);
+
+			} else if (shape==FIT_CIRCLE) {
+
+				double du= u[i]-p[0], dv= v[i]-p[1];
+				r[i]= static_cast<float>(std::sqrt(du*du+dv*dv)-p[2]);
+
+			} else {
+
+				double f= p[0]*u[i]*u[i]+p[1]*u[i]*v[i]+p[2]*v[i]*v[i]+p[3]*u[i]+p[4]*v[i]+p[5];
+				double gu= 2.0*p[0]*u[i]+p[1]*v[i]+p[3];
+				double gv= p[1]*u[i]+2.0*p[2]*v[i]+p[4];
+				double g= std::sqrt(gu*gu+gv*gv);
+				r[i]= static_cast<float>(g>0.0 ? f/g : 0.0);
+			}
+		}
+	}
+
+	// Parameters of set i, in image coordinates
+	void store(int i, const double p[6], double mu, double mv, double scale) const {
+
+		if (shape==FIT_LINE) {
+
+			params[0][i]= static_cast<float>(p[1]);          // direction
+			params[1][i]= static_cast<float>(-p[0]);
+			params[2][i]= static_cast<float>(mu+scale*p[0]*p[2]);  // closest point to the center
+			params[3][i]= static_cast<float>(mv+scale*p[1]*p[2]);
+
+		} else if (shape==FIT_CIRCLE) {
+
+			params[0][i]= static_cast<float>(mu+scale*p[0]);
+			params[1][i]= static_cast<float>(mv+scale*p[1]);
+			params[2][i]= static_cast<float>(scale*p[2]);
+
+		} else {
+
+			// center, then the quadratic form in the frame of the axes
+			double det= 4.0*p[0]*p[2]-p[1]*p[1];
+			double u0= (p[1]*p[4]-2.0*p[2]*p[3])/det;
+			double v0= (p[1]*p[3]-2.0*p[0]*p[4])/det;
+			double f= p[0]*u0*u0+p[1]*u0*v0+p[2]*v0*v0+p[3]*u0+p[4]*v0+p[5];
+			double theta= 0.5*std::atan2(p[1],p[0]-p[2]);
+			double cs= std::cos(theta), sn= std::sin(theta);
+			double along= p[0]*cs*cs+p[1]*cs*sn+p[2]*sn*sn;
+			double across= p[0]*sn*sn-p[1]*cs*sn+p[2]*cs*cs;
+
+			params[0][i]= static_cast<float>(mu+scale*u0);
+			params[1][i]= static_cast<float>(mv+scale*v0);
+			params[2][i]= static_cast<float>(2.0*scale*std::sqrt(std::max(-f/along,0.0)));
+			params[3][i]= static_cast<float>(2.0*scale*std::sqrt(std::max(-f/across,0.0)));
+			params[4][i]= static_cast<float>(theta*180.0/CV_PI);
+		}
+	}
+
+  public:
+
+	RobustFitBody(const PointSetArena& arena, int shape, int estimator, float c, int maxIterations,
+		          float* params[5], FitResiduals& fits)
+		: arena(arena), shape(shape), estimator(estimator), c(c), maxIterations(maxIterations), fits(fits) {
+
+		for (int k=0; k<5; k++)
+			this->params[k]= params[k];
+	}
+
+	void operator()(const cv::Range& range) const {
+
+		static const int minPoints[]= { 2, 3, 5 };
+		int degree= shape+2;
+
+		std::vector<float> u, v, w, a;   // normalized points, weights, absolute residuals
+		double m[15], p[6], previous[6];
+
+		for (int i=range.start; i<range.end; i++) {
+
+			int n= arena.size(i);
+			const float* x= arena.x(i);
+			const float* y= arena.y(i);
+			fits.rms[i]= -1.0f;
+			for (int k=0; k<5; k++)
+				if (params[k])
+					params[k][i]= 0.0f;
+			if (n<minPoints[shape])
+				continue;
+			float* r= &fits.residuals[0]+arena.offset(i);
+			float* wout= &fits.weights[0]+arena.offset(i);
+
+			// centered and scaled points
+			double mu= 0.0, mv= 0.0;
+			for (int j=0; j<n; j++) {
+
+				mu+= x[j];
+				mv+= y[j];
+			}
+			mu/= n;
+			mv/= n;
+			double spread= 0.0;
+			for (int j=0; j<n; j++)
+				spread+= (x[j]-mu)*(x[j]-mu)+(y[j]-mv)*(y[j]-mv);
+			double scale= std::sqrt(spread/n);
+			if (scale==0.0)
+				continue;
+
+			u.resize(n);
+			v.resize(n);
+			a.resize(n);
+			w.assign(n,1.0f);
+			for (int j=0; j<n; j++) {
+
+				u[j]= static_cast<float>((x[j]-mu)/scale);
+				v[j]= static_cast<float>((y[j]-mv)/scale);
+			}
+
+			bool solved= false;
+			for (int it=0; it<maxIterations; it++) {
+
+				moments(&u[0],&v[0],&w[0],n,degree,m);
+				bool ok= shape==FIT_LINE ? solveLine(m,p) : shape==FIT_CIRCLE ? solveCircle(m,p) : solveEllipse(m,p);
+				if (!ok) {
+
+					// keeps the previous solution, if any
+					if (solved)
+						std::copy(previous,previous+6,p);
+					break;
+				}
+				solved= true;
+				std::copy(p,p+6,previous);
+				residuals(&u[0],&v[0],n,p,r);
+				if (estimator==FIT_L2)
+					break;
+
+				// scale of the residuals from their median absolute value
+				for (int j=0; j<n; j++)
+					a[j]= std::abs(r[j]);
+				std::nth_element(a.begin(),a.begin()+n/2,a.end());
+				float k= c*std::max(1.4826f*a[n/2],1e-6f);
+
+				float change= 0.0f;
+				for (int j=0; j<n; j++) {
+
+					float rj= std::abs(r[j]);
+					float wj;
+					if (estimator==FIT_HUBER) {
+
+						wj= rj<=k ? 1.0f : k/rj;
+
+					} else {
+
+						float t= rj/k;
+						wj= t<1.0f ? (1.0f-t*t)*(1.0f-t*t) : 0.0f;
+					}
+					change= std::max(change,std::abs(wj-w[j]));
+					w[j]= wj;
+				}
+				if (change<1e-3f)
+					break;
+			}
+			if (!solved)
+				continue;
+
+			residuals(&u[0],&v[0],n,p,r);
+			double sw= 0.0, swr= 0.0;
+			for (int j=0; j<n; j++) {
+
+				r[j]*= static_cast<float>(scale);
+				wout[j]= w[j];
+				sw+= w[j];
+				swr+= w[j]*r[j]*r[j];
+			}
+			fits.rms[i]= static_cast<float>(sw>0.0 ? std::sqrt(swr/sw) : 0.0);
+			store(i,p,mu,mv,scale);
+		}
+	}
+};
+
+// Fits lines, circles or ellipses to all the sets of an arena, in parallel.
+// Each fit is robust with an M-estimator (Huber or Tukey),
+// or plain least squares (for which a single iteration is done).
+class RobustFitter {
+
+  private:
+
+	  int estimator;
+	  float c;              // tuning constant, in residual scales
+	  int maxIterations;
+
+	  void fit(const PointSetArena& arena, int shape, float* params[5], FitResiduals& fits) {
+
+		  cv::parallel_for_(cv::Range(0,arena.size()),
+			                RobustFitBody(arena,shape,estimator,c,maxIterations,params,fits));
+	  }
+
+  public:
+
+	  RobustFitter(int estimator=FIT_HUBER) : maxIterations(10) {
+
+		  setEstimator(estimator);
+	  }
+
+	  // M-estimator and its tuning constant (0 for the usual 95% efficiency value)
+	  void setEstimator(int e, float constant=0.0f) {
+
+		  estimator= e;
+		  if (constant>0.0f)
+			  c= constant;
+		  else
+			  c= e==FIT_TUKEY ? 4.685f : 1.345f;
+	  }
+
+	  // Maximum number of reweighting iterations
+	  void setIterations(int n) {
+
+		  maxIterations= std::max(n,1);
+	  }
+
+	  void fitLines(const PointSetArena& arena, LineFits& fits) {
+
+		  int n= arena.size();
+		  fits.resize(n,arena.points());
+		  if (n==0)
+			  return;
+		  fits.vx.resize(n); fits.vy.resize(n);
+		  fits.x0.resize(n); fits.y0.resize(n);
+		  float* params[5]= { &fits.vx[0], &fits.vy[0], &fits.x0[0], &fits.y0[0], 0 };
+		  fit(arena,FIT_LINE,params,fits);
+	  }
+
+	  void fitCircles(const PointSetArena& arena, CircleFits& fits) {
+
+		  int n= arena.size();
+		  fits.resize(n,arena.points());
+		  if (n==0)
+			  return;
+		  fits.cx.resize(n); fits.cy.resize(n);
+		  fits.radius.resize(n);
+		  float* params[5]= { &fits.cx[0], &fits.cy[0], &fits.radius[0], 0, 0 };
+		  fit(arena,FIT_CIRCLE,params,fits);
+	  }
+
+	  void fitEllipses(const PointSetArena& arena, EllipseFits& fits) {
+
+		  int n= arena.size();
+		  fits.resize(n,arena.points());
+		  if (n==0)
+			  return;
+		  fits.cx.resize(n); fits.cy.resize(n);
+		  fits.width.resize(n); fits.height.resize(n);
+		  fits.angle.resize(n);
+		  float* params[5]= { &fits.cx[0], &fits.cy[0], &fits.width[0], &fits.height[0], &fits.angle[0] };
+		  fit(arena,FIT_ELLIPSE,params,fits);
+	  }
+};
+
+#endif
@@ -0,0 +1,469 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 7 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined TILEDCANNY
+#define TILEDCANNY
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "blobLabeler.h"
+
+// The connected edge candidates of a tile: a seed pixel and whether
+// the component has a strong pixel, and the component of each pixel
+// on the side of the tile (-1 if not a candidate)
+struct CannyTile {
+
+	std::vector<int> seeds;      // image index of one pixel of each component
+	std::vector<uchar> strong;   // component with a pixel above the high threshold
+	std::vector<int> border;     // top row, bottom row, left column, right column
+};
+
+// Map values of the pixels during the detection
+enum { CANNY_NONE= 0, CANNY_WEAK= 1, CANNY_STRONG= 2, CANNY_PENDING= 3, CANNY_VISITED= 4, CANNY_EDGE= 255 };
+
+// Canny edge candidates of one tile after the other.
+// The gradient of the tile and of a 1-pixel halo is computed (or read),
+// the non-maxima are suppressed exactly as in cv::Canny, and the candidates
+// are grouped into 8-connected components within the tile. Components having
+// a strong pixel are edges; the others are pending until the seams are resolved.
+class CannyTileBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& image;     // CV_8U image, or
+	const cv::Mat& dx;        // CV_16S derivatives
+	const cv::Mat& dy;
+	cv::Mat& map;             // CV_8U, the edges in the end
+	std::vector<CannyTile>& tiles;
+	int tileSize;
+	int low, high;
+	bool l2;
+
+	// Suppresses the non-maxima of the tile core, mag has a 1-pixel halo (0 outside the image)
+	void suppress(const cv::Rect& core, const cv::Mat& gx, const cv::Mat& gy, const cv::Point& offset,
+		          const std::vector<int>& mag, int stride) const {
+
+		const int shift= 15;
+		const int tg22= static_cast<int>(0.4142135623730950488016887242097*(1<<shift) + 0.5);
+
+		for (int y=0; y<core.height; y++) {
+
+			const short* sx= gx.ptr<short>(y+offset.y)+offset.x;
+			const short* sy= gy.ptr<short>(y+offset.y)+offset.x;
+			const int* m0= &mag[(y+1)*stride+1];
+			const int* above= m0-stride;
+			const int* below= m0+stride;
+			uchar* out= map.ptr<uchar>(core.y+y)+core.x;
+
+			for (int x=0; x<core.width; x++) {
+
+				int m= m0[x];
+				uchar v= CANNY_NONE;
+				if (m>low) {
+
+					int xs= sx[x], ys= sy[x];
+					int ax= std::abs(xs);
+					int ay= std::abs(ys)<<shift;
+					int tg22x= ax*tg22;
+					bool maximum;
+					if (ay<tg22x) {
+
+						maximum= m>m0[x-1] && m>=m0[x+1];
+
+					} else {
+
+						int tg67x= tg22x + (ax<<(shift+1));
+						if (ay>tg67x) {
+
+							maximum= m>above[x] && m>=below[x];
+
+						} else {
+
+							int s= (xs^ys)<0 ? -1 : 1;
+							maximum= m>above[x-s] && m>below[x+s];
+						}
+					}
+
+					if (maximum)
+						v= m>high ? CANNY_STRONG : CANNY_WEAK;
+				}
+				out[x]= v;
+			}
+		}
+	}
+
+	// Groups the candidates of the tile into components
+	void group(const cv::Rect& core, CannyTile& tile, std::vector<int>& stack) const {
+
+		int nc= map.cols;
+		int w= core.width;
+		int h= core.height;
+		tile.seeds.clear();
+		tile.strong.clear();
+		tile.border.assign(2*w+2*h,-1);
+
+		for (int y=core.y; y<core.y+h; y++) {
+
+			for (int x=core.x; x<core.x+w; x++) {
+
+				uchar* p= map.ptr<uchar>(y)+x;
+				if (*p!=CANNY_WEAK && *p!=CANNY_STRONG)
+					continue;
+
+				// the component, in breadth-first order
+				int k= static_cast<int>(tile.seeds.size());
+				bool strong= *p==CANNY_STRONG;
+				*p= CANNY_VISITED;
+				stack.assign(1,y*nc+x);
+				for (size_t i=0; i<stack.size(); i++) {
+
+					int px= stack[i]%nc - core.x;
+					int py= stack[i]/nc - core.y;
+					if (py==0) tile.border[px]= k;
+					if (py==h-1) tile.border[w+px]= k;
+					if (px==0) tile.border[2*w+py]= k;
+					if (px==w-1) tile.border[2*w+h+py]= k;
+
+					for (int ny=std::max(py-1,0); ny<=std::min(py+1,h-1); ny++) {
+
+						uchar* row= map.ptr<uchar>(core.y+ny)+core.x;
+						for (int nx=std::max(px-1,0); nx<=std::min(px+1,w-1); nx++) {
+
+							if (row[nx]==CANNY_WEAK || row[nx]==CANNY_STRONG) {
+
+								strong|= row[nx]==CANNY_STRONG;
+								row[nx]= CANNY_VISITED;
+								stack.push_back((core.y+ny)*nc+core.x+nx);
+							}
+						}
+					}
+				}
+
+				uchar value= strong ? CANNY_EDGE : CANNY_PENDING;
+				for (size_t i=0; i<stack.size(); i++)
+					map.data[stack[i]/nc*map.step+stack[i]%nc]= value;
+
+				tile.seeds.push_back(y*nc+x);
+				tile.strong.push_back(strong);
+			}
+		}
+	}
+
+  public:
+
+	CannyTileBody(const cv::Mat& image, const cv::Mat& dx, const cv::Mat& dy, cv::Mat& map,
+		          std::vector<CannyTile>& tiles, int tileSize, int low, int high, bool l2)
+		: image(image), dx(dx), dy(dy), map(map), tiles(tiles), tileSize(tileSize),
+		  low(low), high(high), l2(l2) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nl= map.rows;
+		int nc= map.cols;
+		int ntx= (nc+tileSize-1)/tileSize;
+		int stride= tileSize+2;
+		std::vector<int> mag(stride*stride);
+		std::vector<int> stack;
+		cv::Mat gx, gy;
+
+		for (int t=range.start; t<range.end; t++) {
+
+			cv::Rect core(t%ntx*tileSize, t/ntx*tileSize, tileSize, tileSize);
+			core&= cv::Rect(0,0,nc,nl);
+			cv::Rect halo(core.x-1, core.y-1, core.width+2, core.height+2);
+			halo&= cv::Rect(0,0,nc,nl);
+
+			// the Sobel of an image region uses the pixels around it
+			if (dx.empty()) {
+
+				cv::Sobel(image(halo),gx,CV_16S,1,0,3,1,0,cv::BORDER_REPLICATE);
+				cv::Sobel(image(halo),gy,CV_16S,0,1,3,1,0,cv::BORDER_REPLICATE);
+
+			} else {
+
+				gx= dx(halo);
+				gy= dy(halo);
+			}
+
+			// magnitude of the halo, 0 outside the image
+			std::fill(mag.begin(),mag.end(),0);
+			for (int y=0; y<halo.height; y++) {
+
+				const short* sx= gx.ptr<short>(y);
+				const short* sy= gy.ptr<short>(y);
+				int* m= &mag[(halo.y-core.y+1+y)*stride + halo.x-core.x+1];
+				if (l2) {
+
+					for (int x=0; x<halo.width; x++)
+						m[x]= sx[x]*sx[x] + sy[x]*sy[x];
+
+				} else {
+
+					for (int x=0; x<halo.width; x++)
+						m[x]= std::abs(sx[x]) + std::abs(sy[x]);
+				}
+			}
+
+			suppress(core,gx,gy,core.tl()-halo.tl(),mag,stride);
+			group(core,tiles[t],stack);
+		}
+	}
+};
+
+// Marks the pending components that are connected to an edge through
+// the seams, then clears all the pixels that are not edges.
+class CannyResolveBody : public cv::ParallelLoopBody {
+
+	cv::Mat& map;
+	const std::vector<CannyTile>& tiles;
+	const std::vector<int>& offsets;     // first component of each tile
+	const std::vector<uchar>& edges;     // component connected to a strong pixel
+	int tileSize;
+
+  public:
+
+	CannyResolveBody(cv::Mat& map, const std::vector<CannyTile>& tiles, const std::vector<int>& offsets,
+		             const std::vector<uchar>& edges, int tileSize)
+		: map(map), tiles(tiles), offsets(offsets), edges(edges), tileSize(tileSize) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nl= map.rows;
+		int nc= map.cols;
+		int ntx= (nc+tileSize-1)/tileSize;
+		std::vector<int> stack;
+
+		for (int t=range.start; t<range.end; t++) {
+
+			cv::Rect core(t%ntx*tileSize, t/ntx*tileSize, tileSize, tileSize);
+			core&= cv::Rect(0,0,nc,nl);
+			const CannyTile& tile= tiles[t];
+
+			for (size_t k=0; k<tile.seeds.size(); k++) {
+
+				if (tile.strong[k] || !edges[offsets[t]+k])
+					continue;
+
+				// the component becomes an edge
+				int seed= tile.seeds[k];
+				map.ptr<uchar>(seed/nc)[seed%nc]= CANNY_EDGE;
+				stack.assign(1,seed);
+				while (!stack.empty()) {
+
+					int px= stack.back()%nc;
+					int py= stack.back()/nc;
+					stack.pop_back();
+
+					for (int ny=std::max(py-1,core.y); ny<=std::min(py+1,core.y+core.height-1); ny++) {
+
+						uchar* row= map.ptr<uchar>(ny);
+						for (int nx=std::max(px-1,core.x); nx<=std::min(px+1,core.x+core.width-1); nx++) {
+
+							if (row[nx]==CANNY_PENDING) {
+
+								row[nx]= CANNY_EDGE;
+								stack.push_back(ny*nc+nx);
+							}
+						}
+					}
+				}
+			}
+
+			for (int y=core.y; y<core.y+core.height; y++) {
+
+				uchar* row= map.ptr<uchar>(y);
+				for (int x=core.x; x<core.x+core.width; x++)
+					if (row[x]!=CANNY_EDGE)
+						row[x]= 0;
+			}
+		}
+	}
+};
+
+// Canny edge detector processing the image by tiles in parallel.
+// Gradient, non-maxima suppression and hysteresis within a tile are
+// done by one task; the components of edge candidates that cross
+// the tile seams are then merged with a union-find, and a component
+// is an edge if any of its parts has a strong pixel.
+// Results are identical to those of cv::Canny with a 3x3 aperture;
+// the derivatives can also be given (e.g. by EdgeDetector::computeGradient).
+class TiledCanny {
+
+  private:
+
+	  double lowThreshold;
+	  double highThreshold;
+	  bool l2Gradient;
+	  int tileSize;
+
+	  std::vector<CannyTile> tiles;
+	  std::vector<int> offsets;
+	  std::vector<int> parent;
+	  std::vector<uchar> strong;
+	  std::vector<uchar> edges;
+
+	  // Component of a pixel on the side of its tile (-1 if none)
+	  int component(int x, int y, int nl, int nc) const {
+
+		  int ntx= (nc+tileSize-1)/tileSize;
+		  int t= y/tileSize*ntx + x/tileSize;
+		  int w= std::min(tileSize,nc-x/tileSize*tileSize);
+		  int h= std::min(tileSize,nl-y/tileSize*tileSize);
+		  int px= x%tileSize;
+		  int py= y%tileSize;
+
+		  int k;
+		  if (py==0) k= tiles[t].border[px];
+		  else if (py==h-1) k= tiles[t].border[w+px];
+		  else if (px==0) k= tiles[t].border[2*w+py];
+		  else k= tiles[t].border[2*w+h+py];
+
+		  return k<0 ? -1 : offsets[t]+k;
+	  }
+
+	  // Joins the components of two pixels in different tiles
+	  void join(int x1, int y1, int x2, int y2, int nl, int nc, const LabelSets& sets) const {
+
+		  if (x2<0 || x2>=nc || y2<0 || y2>=nl)
+			  return;
+
+		  int c1= component(x1,y1,nl,nc);
+		  if (c1<0)
+			  return;
+		  int c2= component(x2,y2,nl,nc);
+		  if (c2>=0)
+			  sets.join(c1,c2);
+	  }
+
+	  void detect(const cv::Mat& image, const cv::Mat& dx, const cv::Mat& dy, cv::Mat& result) {
+
+		  // thresholds as in cv::Canny
+		  double lowT= std::min(lowThreshold,highThreshold);
+		  double highT= std::max(lowThreshold,highThreshold);
+		  if (l2Gradient) {
+
+			  lowT= std::min(32767.0,lowT);
+			  highT= std::min(32767.0,highT);
+			  if (lowT>0) lowT*= lowT;
+			  if (highT>0) highT*= highT;
+		  }
+		  int low= cvFloor(lowT);
+		  int high= cvFloor(highT);
+
+		  int nl= result.rows;
+		  int nc= result.cols;
+		  int ntx= (nc+tileSize-1)/tileSize;
+		  int nty= (nl+tileSize-1)/tileSize;
+		  tiles.resize(ntx*nty);
+
+		  cv::parallel_for_(cv::Range(0,ntx*nty),
+			                CannyTileBody(image,dx,dy,result,tiles,tileSize,low,high,l2Gradient));
+
+		  // one union-find entry per component
+		  offsets.resize(tiles.size()+1);
+		  offsets[0]= 0;
+		  for (size_t t=0; t<tiles.size(); t++)
+			  offsets[t+1]= offsets[t]+static_cast<int>(tiles[t].seeds.size());
+		  int n= offsets.back();
+		  parent.resize(n);
+		  for (int i=0; i<n; i++)
+			  parent[i]= i;
+		  LabelSets sets(parent);
+
+		  // 8-connected pixels on each side of the horizontal and vertical seams
+		  for (int y=tileSize; y<nl; y+=tileSize)
+			  for (int x=0; x<nc; x++)
+				  for (int d=-1; d<=1; d++)
+					  join(x,y-1,x+d,y,nl,nc,sets);
+		  for (int x=tileSize; x<nc; x+=tileSize)
+			  for (int y=0; y<nl; y++)
+				  for (int d=-1; d<=1; d++)
+					  join(x-1,y,x,y+d,nl,nc,sets);
+
+		  // a set is an edge if one of its components has a strong pixel
+		  strong.assign(n,0);
+		  for (size_t t=0; t<tiles.size(); t++)
+			  for (size_t k=0; k<tiles[t].seeds.size(); k++)
+				  if (tiles[t].strong[k])
+					  strong[sets.find(offsets[t]+static_cast<int>(k))]= 1;
+		  edges.resize(n);
+		  for (int i=0; i<n; i++)
+			  edges[i]= strong[sets.find(i)];
+
+		  cv::parallel_for_(cv::Range(0,ntx*nty),CannyResolveBody(result,tiles,offsets,edges,tileSize));
+	  }
+
+  public:
+
+	  TiledCanny(double low=100., double high=200.)
+		  : lowThreshold(low), highThreshold(high), l2Gradient(false), tileSize(128) {}
+
+	  void setThresholds(double low, double high) {
+
+		  lowThreshold= low;
+		  highThreshold= high;
+	  }
+
+	  // Use the L2 norm of the gradient (or the L1 norm)
+	  void setL2Gradient(bool flag) {
+
+		  l2Gradient= flag;
+	  }
+
+	  // Size of the tiles processed in parallel
+	  void setTileSize(int size) {
+
+		  tileSize= size<8 ? 8 : size;
+	  }
+
+	  // Detects the edges of a gray-level image (3x3 Sobel)
+	  void detect(const cv::Mat& image, cv::Mat& result) {
+
+		  CV_Assert(image.type()==CV_8UC1);
+
+		  cv::Mat src= image;
+		  if (image.data==result.data)
+			  src= image.clone(); // in-place
+
+		  result.create(src.size(),CV_8U);
+		  if (src.empty())
+			  return;
+
+		  cv::Mat none;
+		  detect(src,none,none,result);
+	  }
+
+	  // Detects the edges from given CV_16S derivatives,
+	  // e.g. those of EdgeDetector::computeGradient
+	  void detect(const cv::Mat& dx, const cv::Mat& dy, cv::Mat& result) {
+
+		  CV_Assert(dx.type()==CV_16SC1 && dy.type()==CV_16SC1 && dx.size()==dy.size());
+
+		  result.create(dx.size(),CV_8U);
+		  if (dx.empty())
+			  return;
+
+		  cv::Mat none;
+		  detect(none,dx,dy,result);
+	  }
+};
+
+#endif
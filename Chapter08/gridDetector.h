@@ -0,0 +1,253 @@
+/*------------------------------------------------------------------------------------------*\
+This file contains material supporting chapter 8 of the book:
+OpenCV3 Computer Vision Application Programming Cookbook
+Third Edition
+by Robert Laganiere, Packt Publishing, 2016.
+
+This program is free software; permission is hereby granted to use, copy, modify,
+and distribute this source code, or portions thereof, for any purpose, without fee,
+subject to the restriction that the copyright notice may not be removed
+or altered from any source or altered source distribution.
+The software is released on an as-is basis and without any warranties of any kind.
+In particular, the software is not guaranteed to be fault-tolerant or free from failure.
+The author disclaims all warranties with regard to this software, any use,
+and any consequent failure, is purely the responsibility of the user.
+
+Copyright (C) 2016 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined GRIDDETECTOR
+#define GRIDDETECTOR
+
+#include <algorithm>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+// Strongest first; ties broken by position so that the order is total
+inline bool strongerKeyPoint(const cv::KeyPoint& a, const cv::KeyPoint& b) {
+
+	if (a.response!=b.response)
+		return a.response>b.response;
+	if (a.pt.y!=b.pt.y)
+		return a.pt.y<b.pt.y;
+	return a.pt.x<b.pt.x;
+}
+
+// FAST on each cell of a grid, with the threshold of the cell.
+// A cell is read with a margin of 4 pixels (circle and non-maxima suppression),
+// so its keypoints are those of the whole image; the threshold is halved
+// while there are fewer than perCell keypoints. The strongest perCell
+// keypoints are moved to the front of the cell's vector (partial selection).
+// Cells not started before the deadline are skipped, and no cell is
+// detected again after it.
+class GridFastBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& image;
+	int gridRows, gridCols;
+	int perCell;                  // keypoints wanted per cell
+	int minThreshold, maxThreshold;
+	bool nonmax;
+	int64 deadline;               // in ticks, 0 for none
+	std::vector<int>& thresholds;
+	std::vector<std::vector<cv::KeyPoint> >& cells;
+	std::vector<uchar>& skipped;
+
+	bool late() const {
+
+		return deadline>0 && cv::getTickCount()>deadline;
+	}
+
+  public:
+
+	GridFastBody(const cv::Mat& image, int gridRows, int gridCols, int perCell, int minThreshold, int maxThreshold,
+		         bool nonmax, int64 deadline, std::vector<int>& thresholds,
+		         std::vector<std::vector<cv::KeyPoint> >& cells, std::vector<uchar>& skipped)
+		: image(image), gridRows(gridRows), gridCols(gridCols), perCell(perCell),
+		  minThreshold(minThreshold), maxThreshold(maxThreshold), nonmax(nonmax), deadline(deadline),
+		  thresholds(thresholds), cells(cells), skipped(skipped) {}
+
+	void operator()(const cv::Range& range) const {
+
+		const int margin= 4;
+
+		for (int c=range.start; c<range.end; c++) {
+
+			std::vector<cv::KeyPoint>& points= cells[c];
+			points.clear();
+			skipped[c]= late();
+			if (skipped[c])
+				continue;
+
+			int i= c/gridCols, j= c%gridCols;
+			cv::Rect cell(j*image.cols/gridCols, i*image.rows/gridRows, 0, 0);
+			cell.width= (j+1)*image.cols/gridCols-cell.x;
+			cell.height= (i+1)*image.rows/gridRows-cell.y;
+			cv::Rect roi(cell.x-margin, cell.y-margin, cell.width+2*margin, cell.height+2*margin);
+			roi&= cv::Rect(0,0,image.cols,image.rows);
+
+			int threshold= thresholds[c];
+			for (;;) {
+
+				cv::FAST(image(roi),points,threshold,nonmax);
+
+				// keypoints of the cell, in image coordinates
+				size_t n= 0;
+				for (size_t k=0; k<points.size(); k++) {
+
+					cv::Point2f p= points[k].pt+cv::Point2f(static_cast<float>(roi.x),static_cast<float>(roi.y));
+					if (p.x>=cell.x && p.x<cell.x+cell.width && p.y>=cell.y && p.y<cell.y+cell.height) {
+
+						points[n]= points[k];
+						points[n++].pt= p;
+					}
+				}
+				points.resize(n);
+
+				if (static_cast<int>(n)>=perCell || threshold<=minThreshold || late())
+					break;
+				threshold= std::max(minThreshold,threshold/2);
+			}
+
+			// threshold of the next frame: raised if the cell has far too many points
+			if (static_cast<int>(points.size())>4*perCell)
+				threshold= std::min(maxThreshold,threshold+threshold/4+1);
+			thresholds[c]= threshold;
+
+			if (static_cast<int>(points.size())>perCell) {
+
+				std::nth_element(points.begin(),points.begin()+perCell,points.end(),strongerKeyPoint);
+				std::sort(points.begin(),points.begin()+perCell,strongerKeyPoint);
+			} else {
+
+				std::sort(points.begin(),points.end(),strongerKeyPoint);
+			}
+		}
+	}
+};
+
+// Detector of well-distributed FAST keypoints: the image is divided into a grid,
+// each cell detects in parallel with its own threshold (adapted from frame
+// to frame) and keeps its strongest keypoints; the keypoints missing in weak
+// cells are then taken among the other candidates, strongest first.
+// The result does not depend on the number of threads, unless the time budget
+// cuts the detection short.
+class GridFastDetector {
+
+  private:
+
+	  int gridRows, gridCols;
+	  int maxKeypoints;       // keypoints wanted per frame
+	  int initialThreshold, minThreshold, maxThreshold;
+	  bool nonmax;
+	  double budget;          // time budget in ms, 0 for none
+
+	  std::vector<int> thresholds;                       // threshold of each cell
+	  std::vector<std::vector<cv::KeyPoint> > cells;     // candidates of each cell
+	  std::vector<uchar> skipped;                        // cells cut by the budget
+	  std::vector<cv::KeyPoint> leftovers;
+
+  public:
+
+	  GridFastDetector(int maxKeypoints=500, int gridRows=4, int gridCols=6)
+		  : gridRows(gridRows), gridCols(gridCols), maxKeypoints(maxKeypoints),
+		    initialThreshold(20), minThreshold(5), maxThreshold(100), nonmax(true), budget(0.0) {}
+
+	  void setGrid(int rows, int cols) {
+
+		  gridRows= rows;
+		  gridCols= cols;
+		  thresholds.clear();
+	  }
+
+	  void setMaxKeypoints(int n) {
+
+		  maxKeypoints= n;
+	  }
+
+	  // Threshold of the first frame and range of the adapted thresholds
+	  void setThresholds(int initial, int minimum, int maximum) {
+
+		  initialThreshold= initial;
+		  minThreshold= minimum;
+		  maxThreshold= maximum;
+		  thresholds.clear();
+	  }
+
+	  void setNonmaxSuppression(bool flag) {
+
+		  nonmax= flag;
+	  }
+
+	  // Time after which no more detection is started (0 for none)
+	  void setTimeBudget(double ms) {
+
+		  budget= ms;
+	  }
+
+	  // Back to the initial threshold in every cell
+	  void reset() {
+
+		  thresholds.clear();
+	  }
+
+	  // Detects up to maxKeypoints keypoints: the strongest of each cell,
+	  // in cell order, then the strongest of the remaining ones
+	  void detect(const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints) {
+
+		  CV_Assert(image.type()==CV_8UC1 && gridRows>0 && gridCols>0);
+
+		  int64 deadline= budget>0.0 ? cv::getTickCount()+static_cast<int64>(budget*cv::getTickFrequency()/1000.) : 0;
+
+		  int nCells= gridRows*gridCols;
+		  if (static_cast<int>(thresholds.size())!=nCells)
+			  thresholds.assign(nCells,initialThreshold);
+		  cells.resize(nCells);
+		  skipped.resize(nCells);
+		  int perCell= std::max(1,maxKeypoints/nCells);
+
+		  cv::parallel_for_(cv::Range(0,nCells),
+			                GridFastBody(image,gridRows,gridCols,perCell,minThreshold,maxThreshold,nonmax,deadline,
+			                             thresholds,cells,skipped));
+
+		  // the strongest of each cell
+		  keypoints.clear();
+		  leftovers.clear();
+		  for (int c=0; c<nCells; c++) {
+
+			  size_t n= std::min(cells[c].size(),static_cast<size_t>(perCell));
+			  keypoints.insert(keypoints.end(),cells[c].begin(),cells[c].begin()+n);
+			  leftovers.insert(leftovers.end(),cells[c].begin()+n,cells[c].end());
+		  }
+
+		  // more cells than keypoints: only the strongest cells are kept
+		  if (static_cast<int>(keypoints.size())>maxKeypoints) {
+
+			  std::nth_element(keypoints.begin(),keypoints.begin()+maxKeypoints,keypoints.end(),strongerKeyPoint);
+			  keypoints.resize(maxKeypoints);
+		  }
+
+		  // completed with the strongest of the other candidates
+		  int missing= maxKeypoints-static_cast<int>(keypoints.size());
+		  if (missing>0 && !leftovers.empty()) {
+
+			  size_t n= std::min(leftovers.size(),static_cast<size_t>(missing));
+			  std::nth_element(leftovers.begin(),leftovers.begin()+n,leftovers.end(),strongerKeyPoint);
+			  keypoints.insert(keypoints.end(),leftovers.begin(),leftovers.begin()+n);
+		  }
+	  }
+
+	  // Threshold to be used by a cell at the next frame
+	  int getThreshold(int row, int col) const {
+
+		  return thresholds.empty() ? initialThreshold : thresholds[row*gridCols+col];
+	  }
+
+	  // Number of cells skipped by the last detection (time budget)
+	  int getSkippedCells() const {
+
+		  return static_cast<int>(std::count(skipped.begin(),skipped.end(),1));
+	  }
+};
+
+#endif
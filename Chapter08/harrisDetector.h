@@ -19,12 +19,219 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #if !defined HARRISD
 #define HARRISD
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <vector>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/features2d.hpp>
 #include <opencv2/imgproc.hpp>
 
+// Corner response and non-maxima suppression of a band of rows in a single pass.
+// The 3x3 Sobel derivatives and their box sums (the structure tensor) are exact
+// integers kept for the few rows in use; each response row (Harris or minimum
+// eigenvalue, scaled as cv::cornerHarris) is computed once from them, and each row
+// of the band is kept where it is the maximum of its window (as with cv::dilate).
+// Positive maxima are appended to the band's vector; the band maximum is also kept.
+class CornerBandBody : public cv::ParallelLoopBody {
+
+	const cv::Mat& image;     // CV_8U image
+	int neighborhood;         // box size of the structure tensor
+	int nonMaxSize;           // window of the non-maxima suppression
+	double k;                 // Harris parameter
+	bool shiTomasi;           // minimum eigenvalue instead of Harris
+	int nBands;
+	std::vector<std::vector<cv::Point> >& corners;
+	std::vector<std::vector<float> >& responses;
+	std::vector<float>& maxima;
+
+	static int reflect(int i, int n) {
+
+		if (n==1)
+			return 0;
+		// repeated while the box is wider than the image, as cv::borderInterpolate
+		while (i<0 || i>=n)
+			i= i<0 ? -i : 2*n-2-i;
+		return i;
+	}
+
+	// Horizontal box sums of the derivative products of row j
+	void tensorRow(int j, int* products, int* sxx, int* sxy, int* syy) const {
+
+		int n= image.cols;
+		int a= neighborhood/2;
+		int w= n+neighborhood-1;
+		const uchar* up= image.ptr<uchar>(reflect(j-1,image.rows));
+		const uchar* row= image.ptr<uchar>(j);
+		const uchar* down= image.ptr<uchar>(reflect(j+1,image.rows));
+
+		// products at padded position a+x, interleaved (xx,xy,yy)
+		for (int x=0; x<n; x++) {
+
+			int l= reflect(x-1,n), r= reflect(x+1,n);
+			int gx= (up[r]-up[l]) + 2*(row[r]-row[l]) + (down[r]-down[l]);
+			int gy= (down[l]-up[l]) + 2*(down[x]-up[x]) + (down[r]-up[r]);
+			int* p= products+3*(a+x);
+			p[0]= gx*gx;
+			p[1]= gx*gy;
+			p[2]= gy*gy;
+		}
+
+		// reflected borders
+		for (int x=0; x<w; x++) {
+
+			if (x>=a && x<a+n)
+				continue;
+			const int* q= products+3*(a+reflect(x-a,n));
+			int* p= products+3*x;
+			p[0]= q[0];
+			p[1]= q[1];
+			p[2]= q[2];
+		}
+
+		for (int x=0; x<n; x++) {
+
+			int s0= 0, s1= 0, s2= 0;
+			const int* p= products+3*x;
+			for (int i=0; i<neighborhood; i++, p+=3) {
+
+				s0+= p[0];
+				s1+= p[1];
+				s2+= p[2];
+			}
+			sxx[x]= s0;
+			sxy[x]= s1;
+			syy[x]= s2;
+		}
+	}
+
+  public:
+
+	CornerBandBody(const cv::Mat& image, int neighborhood, int nonMaxSize, double k, bool shiTomasi, int nBands,
+		           std::vector<std::vector<cv::Point> >& corners, std::vector<std::vector<float> >& responses,
+		           std::vector<float>& maxima)
+		: image(image), neighborhood(neighborhood), nonMaxSize(nonMaxSize), k(k), shiTomasi(shiTomasi),
+		  nBands(nBands), corners(corners), responses(responses), maxima(maxima) {}
+
+	void operator()(const cv::Range& range) const {
+
+		int nl= image.rows;
+		int nc= image.cols;
+		int a= neighborhood/2;
+		int r= nonMaxSize/2;
+
+		// as cv::cornerHarris: derivatives scaled by 1/(4*neighborhood*255)
+		double scale= 1.0/(4.0*neighborhood*255.0);
+		double scale2= scale*scale;
+		double scale4= scale2*scale2;
+
+		// rows cached by index modulo their number: the rows in use never collide
+		std::vector<int> products(3*(nc+neighborhood-1));
+		std::vector<int> tensor(3*neighborhood*nc);
+		std::vector<int> tensorTags(neighborhood);
+		std::vector<float> response(nonMaxSize*nc);
+		std::vector<int> responseTags(nonMaxSize);
+		std::vector<const int*> rows(3*neighborhood);
+
+		for (int b=range.start; b<range.end; b++) {
+
+			int y0= b*nl/nBands;
+			int y1= (b+1)*nl/nBands;
+			std::vector<cv::Point>& points= corners[b];
+			std::vector<float>& values= responses[b];
+			points.clear();
+			values.clear();
+			float bandMax= -FLT_MAX;
+			std::fill(tensorTags.begin(),tensorTags.end(),-1);
+			std::fill(responseTags.begin(),responseTags.end(),-1);
+
+			for (int y=y0; y<y1; y++) {
+
+				// response rows of the suppression window
+				for (int yw=std::max(0,y-r); yw<std::min(nl,y-r+nonMaxSize); yw++) {
+
+					int slot= yw%nonMaxSize;
+					if (responseTags[slot]==yw)
+						continue;
+
+					// tensor rows of the box
+					for (int i=0; i<neighborhood; i++) {
+
+						int j= reflect(yw-a+i,nl);
+						int t= j%neighborhood;
+						int* sxx= &tensor[(3*t)*nc];
+						if (tensorTags[t]!=j) {
+
+							tensorRow(j,&products[0],sxx,sxx+nc,sxx+2*nc);
+							tensorTags[t]= j;
+						}
+						rows[3*i]= sxx;
+						rows[3*i+1]= sxx+nc;
+						rows[3*i+2]= sxx+2*nc;
+					}
+
+					float* out= &response[slot*nc];
+					for (int x=0; x<nc; x++) {
+
+						int sxx= 0, sxy= 0, syy= 0;
+						for (int i=0; i<neighborhood; i++) {
+
+							sxx+= rows[3*i][x];
+							sxy+= rows[3*i+1][x];
+							syy+= rows[3*i+2][x];
+						}
+
+						double dxx= sxx, dxy= sxy, dyy= syy;
+						if (shiTomasi) {
+
+							double hxx= 0.5*dxx, hyy= 0.5*dyy;
+							out[x]= static_cast<float>(scale2*(hxx+hyy-std::sqrt((hxx-hyy)*(hxx-hyy)+dxy*dxy)));
+
+						} else {
+
+							out[x]= static_cast<float>(scale4*(dxx*dyy-dxy*dxy-k*(dxx+dyy)*(dxx+dyy)));
+						}
+					}
+					responseTags[slot]= yw;
+				}
+
+				// maxima of their window
+				const float* current= &response[(y%nonMaxSize)*nc];
+				for (int x=0; x<nc; x++) {
+
+					float v= current[x];
+					bandMax= std::max(bandMax,v);
+					if (v<=0.0f)
+						continue;
+
+					bool isMax= true;
+					for (int yw=std::max(0,y-r); yw<std::min(nl,y-r+nonMaxSize) && isMax; yw++) {
+
+						const float* w= &response[(yw%nonMaxSize)*nc];
+						for (int xw=std::max(0,x-r); xw<std::min(nc,x-r+nonMaxSize); xw++) {
+
+							if (w[xw]>v) {
+
+								isMax= false;
+								break;
+							}
+						}
+					}
+
+					if (isMax) {
+
+						points.push_back(cv::Point(x,y));
+						values.push_back(v);
+					}
+				}
+			}
+
+			maxima[b]= bandMax;
+		}
+	}
+};
+
 class HarrisDetector {
 
   private:
@@ -49,10 +256,17 @@ class HarrisDetector {
 	  int nonMaxSize; 
 	  // kernel for non-max suppression
 	  cv::Mat kernel;
+	  // minimum eigenvalue (Shi-Tomasi) instead of the Harris measure
+	  bool shiTomasi;
+	  // local maxima of each band and their strength (fused detection)
+	  std::vector<std::vector<cv::Point> > bandCorners;
+	  std::vector<std::vector<float> > bandResponses;
+	  std::vector<float> bandMaxima;
 
   public:
 
-	  HarrisDetector() : neighborhood(3), aperture(3), k(0.1), maxStrength(0.0), threshold(0.01), nonMaxSize(3) {
+	  HarrisDetector() : neighborhood(3), aperture(3), k(0.1), maxStrength(0.0), threshold(0.01), nonMaxSize(3),
+		                 shiTomasi(false) {
 	  
 		  setLocalMaxWindowSize(nonMaxSize);
 	  }
@@ -61,14 +275,23 @@ class HarrisDetector {
 	  void setLocalMaxWindowSize(int size) {
 
 		  nonMaxSize= size;
-		  kernel.create(nonMaxSize,nonMaxSize,CV_8U);
+		  kernel= cv::Mat(nonMaxSize,nonMaxSize,CV_8U,cv::Scalar(1));
+	  }
+
+	  // Use the minimum eigenvalue of the structure tensor (Shi-Tomasi)
+	  void setShiTomasi(bool flag) {
+
+		  shiTomasi= flag;
 	  }
 
 	  // Compute Harris corners
 	  void detect(const cv::Mat& image) {
 	
 		  // Harris computation
-		  cv::cornerHarris(image,cornerStrength,
+		  if (shiTomasi)
+			  cv::cornerMinEigenVal(image,cornerStrength,neighborhood,aperture);
+		  else
+			  cv::cornerHarris(image,cornerStrength,
 		             neighborhood,// neighborhood size
 					 aperture,     // aperture size
 					 k);           // Harris parameter
@@ -78,10 +301,37 @@ class HarrisDetector {
 
 		  // local maxima detection
 		  cv::Mat dilated;  // temporary image
-		  cv::dilate(cornerStrength,dilated,cv::Mat());
+		  cv::dilate(cornerStrength,dilated,kernel);
 		  cv::compare(cornerStrength,dilated,localMax,cv::CMP_EQ);
 	  }
 
+	  // Compute the corners in a single pass, in parallel bands:
+	  // same corners as detect and getCorners, without the strength image
+	  void detect(const cv::Mat& image, std::vector<cv::Point> &points, double qualityLevel) {
+
+		  // the integer box sums of squared derivatives (up to 1020^2 each) stay within int
+		  CV_Assert(image.type()==CV_8UC1 && aperture==3 && neighborhood>0 && neighborhood<=45);
+
+		  int nBands= std::max(1,std::min(cv::getNumThreads(),image.rows/16));
+		  bandCorners.resize(nBands);
+		  bandResponses.resize(nBands);
+		  bandMaxima.resize(nBands);
+		  cv::parallel_for_(cv::Range(0,nBands),
+			                CornerBandBody(image,neighborhood,nonMaxSize,k,shiTomasi,nBands,
+			                               bandCorners,bandResponses,bandMaxima),nBands);
+
+		  // threshold relative to the maximum strength
+		  // (local: the strength image of the two-step detection is left unchanged)
+		  double maxResponse= *std::max_element(bandMaxima.begin(),bandMaxima.end());
+		  double minResponse= qualityLevel*maxResponse;
+
+		  points.clear();
+		  for (int b=0; b<nBands; b++)
+			  for (size_t i=0; i<bandCorners[b].size(); i++)
+				  if (bandResponses[b][i]>minResponse)
+					  points.push_back(bandCorners[b][i]);
+	  }
+
 	  // Get the corner map from the computed Harris values
 	  cv::Mat getCornerMap(double qualityLevel) {
 
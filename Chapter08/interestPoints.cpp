@@ -24,6 +24,7 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2/xfeatures2d.hpp>
 
 #include "harrisDetector.h"
+#include "gridDetector.h"
 
 int main()
 {
@@ -66,6 +67,20 @@ int main()
     // Detect Harris corners
 	std::vector<cv::Point> pts;
 	harris.getCorners(pts,0.02);
+
+	// Same corners from the fused single pass, timed against the separate steps
+	int64 start= cv::getTickCount();
+	harris.detect(image);
+	std::vector<cv::Point> stepPts;
+	harris.getCorners(stepPts,0.02);
+	double steps= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+
+	start= cv::getTickCount();
+	std::vector<cv::Point> fusedPts;
+	harris.detect(image,fusedPts,0.02);
+	double fused= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+	std::cout << "Harris corners: " << stepPts.size() << " in " << steps << "ms, fused pass " << fusedPts.size()
+		      << " in " << fused << "ms" << (fusedPts==stepPts ? " (same corners)" : " (different corners)") << std::endl;
 	// Draw Harris corners
 	harris.drawOnImage(image,pts);
 
@@ -222,6 +237,32 @@ int main()
 	cv::namedWindow("FAST Features (grid)");
 	cv::imshow("FAST Features (grid)", image);
 
+	// Grid detector: cells detected in parallel, each with its own threshold
+	// adapted from frame to frame, within a time budget
+	image= cv::imread("church01.jpg",0);
+	// rotate the image (to produce a horizontal image)
+	cv::transpose(image, image);
+	cv::flip(image, image, 0);
+
+	GridFastDetector gridDetector(total, vstep, hstep);
+	gridDetector.setTimeBudget(10.); // ms
+	for (int frame = 0; frame < 3; frame++) {
+
+		start= cv::getTickCount();
+		gridDetector.detect(image, keypoints);
+		double duration= (cv::getTickCount()-start)*1000./cv::getTickFrequency();
+		std::cout << "Adaptive grid, frame " << frame << ": " << keypoints.size() << " keypoints in " << duration
+			      << "ms (" << gridDetector.getSkippedCells() << " cells skipped, threshold of first cell "
+			      << gridDetector.getThreshold(0, 0) << ")" << std::endl;
+	}
+
+	// draw the keypoints
+	cv::drawKeypoints(image, keypoints, image, cv::Scalar(255, 255, 255), cv::DrawMatchesFlags::DRAW_OVER_OUTIMG);
+
+	// Display the keypoints
+	cv::namedWindow("FAST Features (adaptive grid)");
+	cv::imshow("FAST Features (adaptive grid)", image);
+
 	// SURF:
 
 	// Read input image
@@ -24,6 +24,7 @@ Copyright (C) 2016 Robert Laganiere, www.laganiere.name
 #include <opencv2/highgui.hpp>
 
 #include "videoprocessor.h"
+#include "tiledCanny.h"
 
 void draw(const cv::Mat& img, cv::Mat& out) {
 
@@ -31,16 +32,20 @@ void draw(const cv::Mat& img, cv::Mat& out) {
 	cv::circle(out, cv::Point(100,100),5,cv::Scalar(255,0,0),2);
 }
 
+// Canny detector and edge map kept from frame to frame
+TiledCanny tiledCanny(100,200);
+cv::Mat cannyEdges;
+
 // processing function
 void canny(cv::Mat& img, cv::Mat& out) {
 
    // Convert to gray
    if (img.channels()==3)
       cv::cvtColor(img,out,cv::COLOR_BGR2GRAY);
-   // Compute Canny edges
-   cv::Canny(out,out,100,200);
+   // Compute Canny edges, by tiles in parallel
+   tiledCanny.detect(out,cannyEdges);
    // Invert the image
-   cv::threshold(out,out,128,255,cv::THRESH_BINARY_INV);
+   cv::threshold(cannyEdges,out,128,255,cv::THRESH_BINARY_INV);
 }
 
 int main()